@@ -0,0 +1,163 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <cassert>
+
+JobSystem::Worker::Worker(unsigned int queueCapacity, size_t frameReserve_bytes)
+	: queue(queueCapacity), frameAllocator(frameReserve_bytes), steals(0)
+{
+
+}
+
+JobSystem::JobSystem(unsigned int threadCount, size_t frameReserve_bytes, unsigned int queueCapacity)
+	: m_pending(0), m_sleepers(0), m_quit(false)
+{
+	// The calling thread is the last worker.
+	for (unsigned int i = 0; i <= threadCount; ++i)
+		m_workers.push_back(new Worker(queueCapacity, frameReserve_bytes));
+
+	m_threads.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; ++i)
+		m_threads.push_back(std::thread(WorkerMain, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	WaitFrame();
+
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); ++i)
+		m_threads[i].join();
+
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		delete m_workers[i];
+}
+
+void JobSystem::Submit(unsigned int worker, JobFunction function, void* data)
+{
+	// The job lives until the frame allocators are cleared, after the barrier.
+	Job* job = (Job*)m_workers[worker]->frameAllocator.Alloc(sizeof(Job), sizeof(void*));
+	assert(job != nullptr && "Frame allocator exhausted");
+	job->m_function = function;
+	job->m_data = data;
+
+	m_pending.fetch_add(1);
+	m_workers[worker]->queue.Push(job);
+
+	// Sleepers register before checking m_pending, so one side always sees the other.
+	if (m_sleepers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_all();
+	}
+}
+
+Job* JobSystem::FindJob(unsigned int worker)
+{
+	Job* job = m_workers[worker]->queue.Pop();
+	if (job != nullptr)
+		return job;
+
+	unsigned int count = (unsigned int)m_workers.size();
+	for (unsigned int i = 1; i < count; ++i)
+	{
+		job = m_workers[(worker + i) % count]->queue.Steal();
+		if (job != nullptr)
+		{
+			m_workers[worker]->steals++;
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobSystem::Run(Job* job, unsigned int worker)
+{
+	PROFILE_ZONE("Job");
+	job->m_function(job->m_data, worker);
+	m_pending.fetch_sub(1, std::memory_order_release);
+}
+
+// Idle rounds a worker keeps looking for jobs before it goes to sleep, so it is still
+// awake when the next frame starts right after the barrier.
+static const unsigned int IDLE_SPIN_COUNT = 2048;
+
+void JobSystem::WorkerMain(JobSystem* system, unsigned int worker)
+{
+	PROFILE_THREAD_INDEX("Job Worker", worker);
+
+	unsigned int idle = 0;
+	for (;;)
+	{
+		Job* job = system->FindJob(worker);
+		if (job != nullptr)
+		{
+			system->Run(job, worker);
+			idle = 0;
+			continue;
+		}
+
+		// Jobs are still running somewhere and may submit more, keep looking.
+		if (system->m_pending.load() != 0 || ++idle < IDLE_SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		idle = 0;
+
+		std::unique_lock<std::mutex> lock(system->m_sleepMutex);
+		system->m_sleepers.fetch_add(1);
+		if (!system->m_quit && system->m_pending.load() == 0)
+			system->m_wake.wait(lock);
+		system->m_sleepers.fetch_sub(1);
+
+		if (system->m_quit)
+			return;
+	}
+}
+
+void JobSystem::WaitFrame()
+{
+	PROFILE_ZONE("WaitFrame");
+	unsigned int self = GetMainWorker();
+
+	while (m_pending.load(std::memory_order_acquire) != 0)
+	{
+		Job* job = FindJob(self);
+		if (job != nullptr)
+			Run(job, self);
+		else
+			std::this_thread::yield();
+	}
+
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		m_workers[i]->frameAllocator.Clear();
+}
+
+VirtualArena& JobSystem::GetFrameAllocator(unsigned int worker)
+{
+	return m_workers[worker]->frameAllocator;
+}
+
+unsigned int JobSystem::GetWorkerCount() const
+{
+	return (unsigned int)m_workers.size();
+}
+
+unsigned int JobSystem::GetMainWorker() const
+{
+	return (unsigned int)m_workers.size() - 1;
+}
+
+unsigned long long JobSystem::GetStealCount() const
+{
+	unsigned long long steals = 0;
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		steals += m_workers[i]->steals;
+	return steals;
+}
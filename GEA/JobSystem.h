@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "WorkStealingQueue.h"
+#include "Memory/VirtualArena.h"
+
+typedef void (*JobFunction)(void* data, unsigned int worker);
+
+struct Job
+{
+	JobFunction m_function;
+	void* m_data;
+};
+
+/*
+	Persistent worker threads that run jobs through work-stealing queues.
+
+	The thread that creates the system is worker GetMainWorker() and runs jobs too while
+	it waits at the frame barrier. Each worker owns a queue and a frame allocator. Jobs
+	are submitted with the index of the calling worker, which jobs receive as their second
+	argument, and may submit more jobs. WaitFrame returns once every job of the frame,
+	including those submitted by jobs, has finished, and then clears the frame allocators.
+
+	A worker's frame allocator must only be used from that worker.
+*/
+class JobSystem
+{
+public:
+	// threadCount background threads are started on top of the calling thread.
+	JobSystem(unsigned int threadCount, size_t frameReserve_bytes = 64 * 1024 * 1024, unsigned int queueCapacity = 4096);
+	~JobSystem();
+
+	void Submit(unsigned int worker, JobFunction function, void* data);
+
+	// Frame barrier, main worker only.
+	void WaitFrame();
+
+	VirtualArena& GetFrameAllocator(unsigned int worker);
+
+	unsigned int GetWorkerCount() const;
+	unsigned int GetMainWorker() const;
+	unsigned long long GetStealCount() const;
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	struct Worker
+	{
+		Worker(unsigned int queueCapacity, size_t frameReserve_bytes);
+
+		WorkStealingQueue queue;
+		VirtualArena frameAllocator;
+		unsigned long long steals;
+	};
+
+	static void WorkerMain(JobSystem* system, unsigned int worker);
+
+	// Pops from the worker's own queue, or steals from the others.
+	Job* FindJob(unsigned int worker);
+	void Run(Job* job, unsigned int worker);
+
+	std::vector<Worker*> m_workers;
+	std::vector<std::thread> m_threads;
+
+	// Jobs submitted and not finished yet.
+	std::atomic<unsigned int> m_pending;
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<unsigned int> m_sleepers;
+	bool m_quit;
+};
@@ -4,24 +4,63 @@
 #include <fstream>
 #include <cassert>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include "Timer.h"
+#include "ProcessStats.h"
+#include "PerfCounters.h"
 #include "Memory/StackAllocator.h"
 #include "Memory/PoolAllocator.h"
+#include "Memory/MagazinePoolAllocator.h"
+#include "Memory/OwnerPoolAllocator.h"
+#include "Memory/ChunkedPoolAllocator.h"
+#include "Memory/SizeClassAllocator.h"
+#include "Memory/TLSFAllocator.h"
+#include "Memory/BuddyAllocator.h"
+#include "Memory/RelocatableHeap.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/VirtualArena.h"
+#include "Memory/HandlePool.h"
+#include "Memory/DensePool.h"
+#include "Memory/BitmapPool.h"
+#include "ParticleSoA.h"
+#include "JobSystem.h"
+#include "Profiler.h"
 #include "CMDColor.h"
 
 const size_t STACK_TEST_WORKER_COUNT = 4;
 const size_t STACK_TEST_OBJECTS_PER_WORKER = 2048;
 const size_t STACK_TEST_FRAME_COUNT = 1000;
 const size_t STACK_MAX_ALLOC_SIZE = 8192 * 4;
+const size_t STACK_TEST_ALIGNMENT = 16;
+const size_t STACK_TEST_THREAD_BUFFER_SIZE = 1024 * 1024;
+const size_t ARENA_TEST_RESERVE_SIZE = sizeof(void*) == 8 ? (size_t)64 << 30 : (size_t)1 << 30;
+
+const size_t HEAP_TEST_ARENA_SIZE = 128 * 1024 * 1024;
+const size_t HEAP_TEST_DEFRAG_FRAME_BUDGET = 256 * 1024;
+
+const size_t FRAME_TEST_RING_SIZE = 3;
+const size_t FRAME_TEST_FRAME_SIZE = STACK_TEST_OBJECTS_PER_WORKER * STACK_MAX_ALLOC_SIZE;
 
 const size_t POOL_TEST_SPAWN_FRAME_LIMIT = 2048;
 const size_t POOL_TEST_PARTICLE_COUNT = 4096;
 const size_t POOL_TEST_PARTICLE_MAX_LIFETIME = 8;
+const size_t POOL_TEST_GROWABLE_INITIAL_COUNT = POOL_TEST_PARTICLE_COUNT / 16;
+const size_t POOL_TEST_PARALLEL_RANGES_PER_WORKER = 4;
+const size_t POOL_TEST_CACHE_LINE_SIZE = 64;
+const size_t POOL_TEST_LATENCY_ROUNDS = 64;
 
 const size_t POOL_TEST_THREADED_SPAWN_FRAME_LIMIT = 2048;
 const size_t POOL_TEST_THREADED_PARTICLE_COUNT = 4096;
 const size_t POOL_TEST_THREADED_PARTICLE_MAX_LIFETIME = 8;
 const size_t POOL_TEST_THREADED_WORKER_COUNT = 4;
+const size_t POOL_TEST_MAGAZINE_CAPACITY = 64;
+const size_t POOL_TEST_PRODUCER_SPAWN_COUNT = 1024;
+const size_t POOL_TEST_RELEASE_CHUNK_SIZE = 256 * 1024;
+const size_t POOL_TEST_RELEASE_IDLE_FRAMES = 1024;
+const size_t POOL_TEST_RELEASE_TRICKLE_COUNT = 256;
+const size_t POOL_TEST_RELEASE_SAMPLE_INTERVAL = 256;
 
 struct Particle
 {
@@ -34,37 +73,166 @@ struct Particle
 	char data[8192];
 };
 
+// Variable-size counterpart of DefaultMemoryManager.
+struct DefaultHeap
+{
+	void* Alloc(size_t size_bytes) { return malloc(size_bytes); }
+	void Free(void* ptr) { free(ptr); }
+};
+
+// new/delete behind the frame test interface of RingFrameAllocator.
+struct DefaultFrameAllocator
+{
+	void BeginFrame() {}
+	void* Alloc(size_t size_bytes) { return new char[size_bytes]; }
+	void Retire(long long) {}
+};
+
+// Blocks of the frames in flight between the producer and consumer of a frame test.
+struct FrameTestQueue
+{
+	std::vector<void*> blocks[FRAME_TEST_RING_SIZE];
+	std::atomic<long long> produced;
+	std::atomic<long long> consumed;
+};
+
+// Arguments of one StackTestCustom job.
+struct StackTestJob
+{
+	StackMemoryManager* stack;
+	size_t bufferSize;
+	size_t* waste;
+};
+
+// Particles that died in one worker's ranges during a PoolTestParallel frame.
+// The padding keeps the count of one worker off the cache line of the next list.
+struct PoolTestDeadList
+{
+	Particle* particles[POOL_TEST_PARTICLE_COUNT];
+	size_t slots[POOL_TEST_PARTICLE_COUNT];
+	size_t count;
+	char padding[64];
+};
+
+// Arguments of one PoolTestParallel update job.
+struct PoolTestRange
+{
+	Particle** particles;
+	size_t begin;
+	size_t end;
+	PoolTestDeadList* deadLists;
+};
+
+// Frame times of one test in milliseconds, fed with the result of Timer::Stop.
+struct FrameStats
+{
+	FrameStats()
+		: frameCount(0), totalTime(0.0), minTime(+100000000.0), maxTime(-100000000.0)
+	{
+	}
+
+	void Add(double elapsed)
+	{
+		totalTime += elapsed;
+		frameCount++;
+
+		if (elapsed < minTime)
+			minTime = elapsed;
+		if (elapsed > maxTime)
+			maxTime = elapsed;
+	}
+
+	double GetAverage() const
+	{
+		return totalTime / frameCount;
+	}
+
+	// Prints the average, min and max frame time, each line prefixed with indent.
+	void Print(const char* indent = "") const
+	{
+		std::cout << indent << "Average Frame Time: " << GetAverage() << std::endl;
+		std::cout << indent << "Min Frame Time: " << minTime << std::endl;
+		std::cout << indent << "Max Frame Time: " << maxTime << std::endl;
+	}
+
+	int frameCount;
+	double totalTime;
+	double minTime;
+	double maxTime;
+};
+
 int RND[POOL_TEST_PARTICLE_COUNT];
 int RNDThreaded[POOL_TEST_THREADED_PARTICLE_COUNT];
 int RNDStack[STACK_TEST_OBJECTS_PER_WORKER];
 
 template <typename T>
-void PoolTestUnthreaded(T& allocator, bool custom);
+void PoolTestUnthreaded(T& allocator, const char* name);
+
+template <typename T>
+void PoolTestThreaded(T& allocator, const char* name);
+
+template <typename T>
+void PoolTestLatency(T& allocator);
+
+template <typename T>
+void PoolTestTask(T& allocator, int tid, std::mutex& coutmtx, const char* name);
+
+void PoolTestThreadedMagazine(MagazinePoolAllocator& allocator);
+void PoolTestMagazineTask(MagazinePoolAllocator& allocator, int tid, std::mutex& coutmtx);
 
 template <typename T>
-void PoolTestThreaded(T& allocator, bool custom);
+void PoolTestProducerConsumer(T& allocator);
+template <typename T>
+void PoolTestConsumer(T& allocator, FrameTestQueue& queue, double& freeTime);
 
+void PoolTestHandles();
+void PoolTestDense();
+void PoolTestBitmap();
+void PoolTestSoA();
 template <typename T>
-void PoolTestTask(T& allocator, int tid, std::mutex& coutmtx, bool custom);
+void PoolTestParallel(T& allocator, unsigned int workerCount, const char* name);
+void PoolTestParallelUpdate(void* data, unsigned int worker);
+void PoolInitTest(PoolInit init);
+void PoolBackingTest(BackingStore& store, const char* name);
+void PoolReleaseTest(ChunkRelease release, const char* name);
 
 void MultiplePoolTestThreaded();
 void MultiplePoolTestTask(int tid, std::mutex& coutmtx);
 
 void PoolTestWriteCaptions(std::fstream& file);
-void PoolTestWriteFrameData(std::fstream& file, int frameNumber, double elapsed, int creations, int deletions, int allocationSize);
+void PoolTestWriteFrameData(std::fstream& file, int frameNumber, double elapsed, int creations, int deletions, int allocationSize, const PerfCounters& counters);
+void PoolTestPrintCounters(const PerfCounters& counters, int frameCount, const char* indent = "");
 
-double StackTestCustom();
+double StackTestCustom(StackSync sync = STACK_SYNC_MUTEX, size_t bufferSize = 0);
 void StackTestTaskCustom(StackMemoryManager& stack);
+void StackTestTaskBuffered(StackMemoryManager& stack, size_t bufferSize, size_t& waste);
 double StackTestDefault();
 void StackTestTaskDefault();
+double StackTestJobFrame();
+void StackTestJobCustom(void* data, unsigned int worker);
+void StackTestJobBuffered(void* data, unsigned int worker);
+void StackTestJobDefault(void* data, unsigned int worker);
+void StackTestJobFrameTask(void* data, unsigned int worker);
+
+template <typename T>
+double HeapTest(T& allocator, double& maxFrameTime);
+void HeapTestDefrag(size_t frameBudget_bytes);
+
+template <typename T>
+double FrameTest(T& allocator);
+template <typename T>
+void FrameTestConsumer(T& allocator, FrameTestQueue& queue);
 
 double StackTestCustomUnthreaded();
 double StackTestDefaultUnthreaded();
+double StackTestScopedUnthreaded();
+double StackTestArenaUnthreaded(bool decommit);
 void StackTestTaskCustomSameSize(StackMemoryManager& stack);
 
 int main()
 {
 	ColorCMD::ConsoleColorInit();
+	PROFILE_THREAD("Main");
 	srand(13);
 	for (int i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
 	{
@@ -83,6 +251,27 @@ int main()
 		rndStackSum += RNDStack[i];
 	}
 
+	//Print timer parameters, the overhead is subtracted from every measurement below
+	ColorCMD::SetTextColor(ColorCMD::ConsoleColor::AQUA);
+	std::cout << "TIMER_OS_OVERHEAD: " << Timer::GetOverhead(TIMER_SOURCE_OS) * 1000000.0 << " ns" << std::endl;
+	if (Timer::HasTSC())
+	{
+		std::cout << "TIMER_TSC_FREQUENCY: " << Timer::GetFrequency(TIMER_SOURCE_TSC) / 1000000.0 << " MHz" << std::endl;
+		std::cout << "TIMER_TSC_OVERHEAD: " << Timer::GetOverhead(TIMER_SOURCE_TSC) * 1000000.0 << " ns" << std::endl;
+	}
+	else
+	{
+		std::cout << "TIMER_TSC: unavailable, per-call timings use the OS clock" << std::endl;
+	}
+
+	// Counters the system refuses are left out of the pool test output and CSVs.
+	PerfCounters perfCounters;
+	std::cout << "PERF_COUNTERS:";
+	for (unsigned i = 0; i < PERF_COUNTER_COUNT; ++i)
+		std::cout << " " << PerfCounters::GetName((PerfCounter)i) << (perfCounters.IsAvailable((PerfCounter)i) ? "" : " (unavailable)") << (i + 1 < PERF_COUNTER_COUNT ? "," : "");
+	std::cout << std::endl;
+	std::cout << std::endl;
+
 	//Print stack test parameters
 	ColorCMD::SetTextColor(ColorCMD::ConsoleColor::AQUA);
 	std::cout << "STACK_TEST_WORKER_COUNT: " << STACK_TEST_WORKER_COUNT << std::endl;
@@ -97,16 +286,69 @@ int main()
 	std::cout << "-- Stack Test Unthreaded (Custom) --" << std::endl; double stackTestCustomTimeAvg = StackTestCustomUnthreaded();	std::cout << std::endl;	
 	std::cout << "-- Stack Test Unthreaded (Default) --" << std::endl; double stackTestDefaultTimeAvg = StackTestDefaultUnthreaded(); std::cout << std::endl;
 
-	std::cout << "Average Frame Time Difference: " << abs(stackTestCustomTimeAvg - stackTestDefaultTimeAvg) << std::endl << std::endl;
+	std::cout << "Average Frame Time Difference: " << std::fabs(stackTestCustomTimeAvg - stackTestDefaultTimeAvg) << std::endl << std::endl;
+
+	std::cout << "-- Stack Test Unthreaded (Scoped, Aligned) --" << std::endl; StackTestScopedUnthreaded(); std::cout << std::endl;
+	std::cout << "-- Stack Test Unthreaded (Virtual Arena) --" << std::endl; StackTestArenaUnthreaded(false); std::cout << std::endl;
+	std::cout << "-- Stack Test Unthreaded (Virtual Arena, Decommit) --" << std::endl; StackTestArenaUnthreaded(true); std::cout << std::endl;
 
 	std::cout << "-- Stack Test Threaded (Custom) --" << std::endl;	 double stackTestCustomThreadedAvg = StackTestCustom();		std::cout << std::endl;
 	std::cout << "-- Stack Test Threaded (Default) --" << std::endl;  double stackTestDefaultThreadedAvg = StackTestDefault();	std::cout << std::endl;
 
-	std::cout << "Average Frame Time Difference: " << abs(stackTestCustomThreadedAvg - stackTestDefaultThreadedAvg) << std::endl << std::endl;
+	std::cout << "Average Frame Time Difference: " << std::fabs(stackTestCustomThreadedAvg - stackTestDefaultThreadedAvg) << std::endl << std::endl;
+
+	std::cout << "-- Stack Test Threaded (Atomic) --" << std::endl;	 StackTestCustom(STACK_SYNC_ATOMIC);		std::cout << std::endl;
+	std::cout << "-- Stack Test Threaded (Thread Buffers) --" << std::endl;	 StackTestCustom(STACK_SYNC_ATOMIC, STACK_TEST_THREAD_BUFFER_SIZE);		std::cout << std::endl;
+	std::cout << "-- Stack Test Threaded (Job Frame Allocators) --" << std::endl;	 StackTestJobFrame();		std::cout << std::endl;
+
+	DoubleBufferedAllocator* doubleBuffered = new DoubleBufferedAllocator(FRAME_TEST_FRAME_SIZE);
+	std::cout << "-- Frame Test (Double Buffered) --" << std::endl; FrameTest(*doubleBuffered); std::cout << std::endl;
+	delete doubleBuffered;
+
+	RingFrameAllocator* ring = new RingFrameAllocator(FRAME_TEST_FRAME_SIZE, FRAME_TEST_RING_SIZE);
+	std::cout << "-- Frame Test (Ring) --" << std::endl; FrameTest(*ring); std::cout << std::endl;
+	delete ring;
+
+	DefaultFrameAllocator defaultFrame;
+	std::cout << "-- Frame Test (Default) --" << std::endl; FrameTest(defaultFrame); std::cout << std::endl;
+
+	double heapTestSizeClassMax, heapTestTLSFMax, heapTestBuddyMax, heapTestDefaultMax;
+
+	// Every custom heap is prefaulted so first-touch page faults don't land in the timed frames.
+	std::cout << "-- Heap Test (Size Classes) --" << std::endl;
+	SizeClassAllocator* sizeClassHeap = new SizeClassAllocator(HEAP_TEST_ARENA_SIZE, true);
+	double heapTestSizeClassAvg = HeapTest(*sizeClassHeap, heapTestSizeClassMax);
+	std::cout << "Arena Used: " << sizeClassHeap->GetArenaUsed() / 1024 << " KB" << std::endl << std::endl;
+	delete sizeClassHeap;
+
+	PageBackingStore tlsfStore(PAGE_BACKING_PREFAULT);
+	void* tlsfRegion = tlsfStore.Allocate(HEAP_TEST_ARENA_SIZE);
+	TLSFAllocator* tlsfHeap = new TLSFAllocator(tlsfRegion, HEAP_TEST_ARENA_SIZE);
+	std::cout << "-- Heap Test (TLSF) --" << std::endl; HeapTest(*tlsfHeap, heapTestTLSFMax); std::cout << std::endl;
+	delete tlsfHeap;
+	tlsfStore.Release(tlsfRegion, HEAP_TEST_ARENA_SIZE);
+
+	BuddyAllocator* buddyHeap = new BuddyAllocator(HEAP_TEST_ARENA_SIZE, 64, true);
+	std::cout << "-- Heap Test (Buddy) --" << std::endl; HeapTest(*buddyHeap, heapTestBuddyMax); std::cout << std::endl;
+	delete buddyHeap;
+
+	DefaultHeap defaultHeap;
+	std::cout << "-- Heap Test (Default) --" << std::endl; double heapTestDefaultAvg = HeapTest(defaultHeap, heapTestDefaultMax); std::cout << std::endl;
+
+	std::cout << "Average Frame Time Difference: " << std::fabs(heapTestSizeClassAvg - heapTestDefaultAvg) << std::endl;
+	std::cout << "Max Frame Time (Size Classes / TLSF / Buddy / Default): " << heapTestSizeClassMax << " / " << heapTestTLSFMax << " / " << heapTestBuddyMax << " / " << heapTestDefaultMax << std::endl << std::endl;
+
+	std::cout << "-- Heap Test (Incremental Defrag) --" << std::endl; HeapTestDefrag(HEAP_TEST_DEFRAG_FRAME_BUDGET); std::cout << std::endl;
+	std::cout << "-- Heap Test (Full Defrag) --" << std::endl; HeapTestDefrag((size_t)-1); std::cout << std::endl;
 
 	DefaultMemoryManager defaultMM(sizeof(Particle));
 	PoolAllocator poolMM(sizeof(Particle), POOL_TEST_PARTICLE_COUNT);
+	PoolAllocator growablePoolMM(sizeof(Particle), POOL_TEST_GROWABLE_INITIAL_COUNT, POOL_GROWTH_GEOMETRIC, POOL_TEST_PARTICLE_COUNT);
 	ThreadedPoolAllocator threadedPoolMM(sizeof(Particle), POOL_TEST_THREADED_PARTICLE_COUNT * POOL_TEST_THREADED_WORKER_COUNT);
+	LockFreePoolAllocator lockFreePoolMM(sizeof(Particle), POOL_TEST_THREADED_PARTICLE_COUNT * POOL_TEST_THREADED_WORKER_COUNT);
+	MagazinePoolAllocator magazinePoolMM(sizeof(Particle), (POOL_TEST_THREADED_PARTICLE_COUNT + POOL_TEST_MAGAZINE_CAPACITY) * POOL_TEST_THREADED_WORKER_COUNT);
+	ThreadedPoolAllocator producerPoolMM(sizeof(Particle), POOL_TEST_PRODUCER_SPAWN_COUNT * (FRAME_TEST_RING_SIZE + 1));
+	OwnerPoolAllocator ownerPoolMM(sizeof(Particle), POOL_TEST_PRODUCER_SPAWN_COUNT * (FRAME_TEST_RING_SIZE + 1));
 
 	//Print pool test parameters
 	ColorCMD::SetTextColor(ColorCMD::ConsoleColor::AQUA);
@@ -116,8 +358,46 @@ int main()
 	std::cout << std::endl;
 	ColorCMD::SetTextColor(ColorCMD::ConsoleColor::WHITE);
 
-	std::cout << "-- Pool Test Unthreaded (Custom) --" << std::endl;				PoolTestUnthreaded(poolMM, true);				std::cout << std::endl;
-	std::cout << "-- Pool Test Unthreaded (Default) --" << std::endl;				PoolTestUnthreaded(defaultMM, false);				std::cout << std::endl;
+	std::cout << "-- Pool Init Test (Eager) --" << std::endl;						PoolInitTest(POOL_INIT_EAGER);						std::cout << std::endl;
+	std::cout << "-- Pool Init Test (Lazy) --" << std::endl;						PoolInitTest(POOL_INIT_LAZY);						std::cout << std::endl;
+
+	std::cout << "-- Pool Test Unthreaded (Custom) --" << std::endl;				PoolTestUnthreaded(poolMM, "custom");				std::cout << std::endl;
+	std::cout << "-- Pool Test Unthreaded (Default) --" << std::endl;				PoolTestUnthreaded(defaultMM, "default");				std::cout << std::endl;
+
+	std::cout << "-- Pool Test Per-Call Latency (Custom) --" << std::endl;			PoolTestLatency(poolMM);							std::cout << std::endl;
+	std::cout << "-- Pool Test Per-Call Latency (Default) --" << std::endl;			PoolTestLatency(defaultMM);							std::cout << std::endl;
+
+	MallocBackingStore mallocStore;
+	PageBackingStore mmapStore;
+	PageBackingStore hugePageStore(PAGE_BACKING_HUGE_PAGES);
+	PageBackingStore hugeTLBStore(PAGE_BACKING_HUGETLB);
+	PageBackingStore prefaultStore(PAGE_BACKING_PREFAULT);
+
+	std::cout << "-- Pool Test Unthreaded (malloc Backing) --" << std::endl;			PoolBackingTest(mallocStore, "backing_malloc");			std::cout << std::endl;
+	std::cout << "-- Pool Test Unthreaded (mmap Backing) --" << std::endl;			PoolBackingTest(mmapStore, "backing_mmap");				std::cout << std::endl;
+	std::cout << "-- Pool Test Unthreaded (Huge Page Backing) --" << std::endl;		PoolBackingTest(hugePageStore, "backing_hugepage");		std::cout << std::endl;
+	std::cout << "-- Pool Test Unthreaded (HugeTLB Backing) --" << std::endl;		PoolBackingTest(hugeTLBStore, "backing_hugetlb");
+	std::cout << "HugeTLB Fallbacks: " << hugeTLBStore.GetFallbackCount() << std::endl << std::endl;
+	std::cout << "-- Pool Test Unthreaded (Prefaulted Backing) --" << std::endl;		PoolBackingTest(prefaultStore, "backing_prefault");		std::cout << std::endl;
+
+	std::cout << "-- Pool Test Unthreaded (Handles) --" << std::endl;				PoolTestHandles();								std::cout << std::endl;
+
+	std::cout << "-- Pool Test Unthreaded (Dense) --" << std::endl;					PoolTestDense();								std::cout << std::endl;
+
+	std::cout << "-- Pool Test Unthreaded (Bitmap) --" << std::endl;					PoolTestBitmap();								std::cout << std::endl;
+
+	std::cout << "-- Pool Test Unthreaded (SoA, SIMD) --" << std::endl;				PoolTestSoA();									std::cout << std::endl;
+
+	std::cout << "-- Pool Test Parallel (Custom, 1 Worker) --" << std::endl;			PoolTestParallel(poolMM, 1, "custom_1");			std::cout << std::endl;
+	std::cout << "-- Pool Test Parallel (Custom, 2 Workers) --" << std::endl;			PoolTestParallel(poolMM, 2, "custom_2");			std::cout << std::endl;
+	std::cout << "-- Pool Test Parallel (Custom, " << POOL_TEST_THREADED_WORKER_COUNT << " Workers) --" << std::endl;	PoolTestParallel(poolMM, POOL_TEST_THREADED_WORKER_COUNT, "custom_n");	std::cout << std::endl;
+
+	std::cout << "-- Pool Release Test (Keep) --" << std::endl;						PoolReleaseTest(CHUNK_RELEASE_NONE, "release_keep");		std::cout << std::endl;
+	std::cout << "-- Pool Release Test (Decommit) --" << std::endl;					PoolReleaseTest(CHUNK_RELEASE_DECOMMIT, "release_decommit");	std::cout << std::endl;
+	std::cout << "-- Pool Release Test (Lazy) --" << std::endl;						PoolReleaseTest(CHUNK_RELEASE_LAZY, "release_lazy");		std::cout << std::endl;
+
+	std::cout << "-- Pool Test Unthreaded (Growable) --" << std::endl;				PoolTestUnthreaded(growablePoolMM, "growable");
+	std::cout << "Pool Capacity: " << growablePoolMM.GetCapacity() << " in " << growablePoolMM.GetChunkCount() << " chunks" << std::endl << std::endl;
 	std::cout << std::endl;
 
 	ColorCMD::SetTextColor(ColorCMD::ConsoleColor::AQUA);
@@ -128,11 +408,22 @@ int main()
 	std::cout << std::endl;
 	ColorCMD::SetTextColor(ColorCMD::ConsoleColor::WHITE);
 
-	std::cout << "-- Pool Test Threaded (Custom) --" << std::endl;					PoolTestThreaded(threadedPoolMM, true);			std::cout << std::endl;
-	std::cout << "-- Pool Test Threaded (Default) --" << std::endl;					PoolTestThreaded(defaultMM, false);				std::cout << std::endl;
+	std::cout << "-- Pool Test Threaded (Custom) --" << std::endl;					PoolTestThreaded(threadedPoolMM, "custom");			std::cout << std::endl;
+	std::cout << "-- Pool Test Threaded (Default) --" << std::endl;					PoolTestThreaded(defaultMM, "default");				std::cout << std::endl;
+	std::cout << "-- Pool Test Threaded (Lock-free) --" << std::endl;				PoolTestThreaded(lockFreePoolMM, "lockfree");		std::cout << std::endl;
+	std::cout << "-- Pool Test Threaded (Magazine) --" << std::endl;				PoolTestThreadedMagazine(magazinePoolMM);		std::cout << std::endl;
 
 	std::cout << "-- Multiple Pool Test Threaded (Custom) --" << std::endl;			MultiplePoolTestThreaded();				std::cout << std::endl;
 
+	std::cout << "-- Pool Test Producer/Consumer (Custom) --" << std::endl;			PoolTestProducerConsumer(producerPoolMM);			std::cout << std::endl;
+	std::cout << "-- Pool Test Producer/Consumer (Remote Free) --" << std::endl;		PoolTestProducerConsumer(ownerPoolMM);
+	std::cout << "Reclaims: " << ownerPoolMM.GetReclaimCount() << " (" << ownerPoolMM.GetReclaimedCount() << " elements)" << std::endl << std::endl;
+
+#ifdef GEA_PROFILE
+	Profiler::WriteChromeTrace("trace.json");
+	std::cout << "Profiler Events: " << Profiler::GetEventCount() << " written to trace.json" << std::endl << std::endl;
+#endif
+
 	std::cout << "Hej" << std::endl;
 	std::cin.get();
 	return 0;
@@ -145,167 +436,230 @@ int main()
 	The time for allocation and deallocation every frame will be measured.
 */
 template <typename T>
-void PoolTestUnthreaded(T& allocator, bool custom)
+void PoolTestUnthreaded(T& allocator, const char* name)
 {
 	std::stringstream ss;
-	ss << "pool_unthreaded_" << (custom ? "custom" : "default") << ".csv";
+	ss << "pool_unthreaded_" << name << ".csv";
 	
 	std::fstream file;
 	file.open(ss.str(), std::ios_base::trunc | std::ios_base::out);
 	PoolTestWriteCaptions(file);
+	PerfCounters counters;
 
 	Timer frameTimer;
 	bool running = true;
 	
 	size_t freeList[POOL_TEST_PARTICLE_COUNT];
 	Particle* particles[POOL_TEST_PARTICLE_COUNT];
+	void* spawnBatch[POOL_TEST_PARTICLE_COUNT];
+	void* deadBatch[POOL_TEST_PARTICLE_COUNT];
 
 	for(unsigned i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+	{
 		freeList[i] = i;
+		particles[i] = nullptr;
+	}
 
 	int freeListIndex = POOL_TEST_PARTICLE_COUNT - 1;
 	int frameCount = 0;
-	double totalTime = 0.0;
-	double minTime = +100000000.0;
-	double maxTime = -100000000.0;
+	FrameStats stats;
 
 	while (running)
 	{
 		int creations = 0;
 		int deletions = 0;
 
+		PROFILE_FLUSH();
+
 		// Start timing
+		counters.Start();
 		frameTimer.Start();
+		PROFILE_ZONE("Pool Frame");
 
-		// Allocate particle objects
-		while (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT && freeListIndex != -1)
+		// Allocate particle objects, the whole frame's spawns in one batch.
+		if (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT && freeListIndex != -1)
 		{
-			creations++;
+			PROFILE_ZONE("Spawn");
+			unsigned spawnCount = allocator.AllocN(spawnBatch, freeListIndex + 1);
 
-			int lifetime = RND[freeList[freeListIndex]];
-			Particle* p = new(allocator.Alloc()) Particle(lifetime);
-			
-			particles[freeList[freeListIndex--]] = p;
+			for (unsigned k = 0; k < spawnCount; ++k)
+			{
+				creations++;
+
+				int lifetime = RND[freeList[freeListIndex]];
+				Particle* p = new(spawnBatch[k]) Particle(lifetime);
+
+				particles[freeList[freeListIndex--]] = p;
+			}
 		}
 
 		// Update simulation of particles (increase lived time)
 		// Deallocate dead particle objects.
-		for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
 		{
-			Particle*& particle = particles[i];
-
-			if(particle != nullptr)
+			PROFILE_ZONE("Update");
+			for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
 			{
-				particle->framesLeftToLive--;
+				Particle*& particle = particles[i];
 
-				if (particle->framesLeftToLive <= 0)
+				if(particle != nullptr)
 				{
-					deletions++;
+					particle->framesLeftToLive--;
 
-					allocator.Free(particle);
+					if (particle->framesLeftToLive <= 0)
+					{
+						deadBatch[deletions++] = particle;
 
-					particle = nullptr;
-					freeList[++freeListIndex] = i;
+						particle = nullptr;
+						freeList[++freeListIndex] = i;
+					}
 				}
 			}
 		}
 
+		// Return the frame's dead particles in one batch.
+		{
+			PROFILE_ZONE("Free");
+			allocator.FreeN(deadBatch, deletions);
+		}
+
 		// Check if all are dead and terminate.
 		running = (freeListIndex != POOL_TEST_PARTICLE_COUNT - 1) || (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT);
 
 		// Measure time.
 		double elapsed = frameTimer.Stop();
+		counters.Stop();
 
-		if (elapsed < minTime)
-			minTime = elapsed;
-		if (elapsed > maxTime)
-			maxTime = elapsed;
+		stats.Add(elapsed);
 
 		// Store profiling data.
-		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle));
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
 
-		totalTime += elapsed;
 		frameCount++;
 	}
 
 	std::cout << "Frames Simulated: " << frameCount << std::endl;
-	std::cout << "Total Experiment Time: " << totalTime << std::endl;
-	std::cout << "Average Frame Time: " << totalTime / frameCount << std::endl;
-	std::cout << "Min Frame Time: " << minTime << std::endl;
-	std::cout << "Max Frame Time: " << maxTime << std::endl;
+	std::cout << "Total Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print();
+	PoolTestPrintCounters(counters, frameCount);
 }
 
+/*
+	Times every single Alloc and Free of a pool with the TSC timer. The pool is filled
+	and emptied POOL_TEST_LATENCY_ROUNDS times, freeing in allocation order.
+*/
 template <typename T>
-void PoolTestThreaded(T& allocator, bool custom)
+void PoolTestLatency(T& allocator)
 {
-	std::mutex coutmtx;
-	std::vector<std::thread> workers;
-	workers.reserve(POOL_TEST_THREADED_WORKER_COUNT);
-
-	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
+	Timer callTimer(TIMER_SOURCE_TSC);
+	void* elements[POOL_TEST_PARTICLE_COUNT];
+
+	unsigned long long callCount = 0;
+	double allocTotal = 0.0;
+	double allocMin = +100000000.0;
+	double allocMax = -100000000.0;
+	double freeTotal = 0.0;
+	double freeMin = +100000000.0;
+	double freeMax = -100000000.0;
+
+	for (size_t round = 0; round < POOL_TEST_LATENCY_ROUNDS; ++round)
 	{
-		workers.push_back(std::thread(PoolTestTask<T>, std::ref(allocator), k, std::ref(coutmtx), custom));
-	}
+		for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+		{
+			callTimer.Start();
+			elements[i] = allocator.Alloc();
+			double elapsed = callTimer.Stop();
+
+			allocTotal += elapsed;
+			if (elapsed < allocMin)
+				allocMin = elapsed;
+			if (elapsed > allocMax)
+				allocMax = elapsed;
+		}
 
-	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
-	{
-		workers[k].join();
+		for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+		{
+			callTimer.Start();
+			allocator.Free(elements[i]);
+			double elapsed = callTimer.Stop();
+
+			freeTotal += elapsed;
+			if (elapsed < freeMin)
+				freeMin = elapsed;
+			if (elapsed > freeMax)
+				freeMax = elapsed;
+		}
+
+		callCount += POOL_TEST_PARTICLE_COUNT;
 	}
+
+	// Milliseconds to nanoseconds.
+	std::cout << "Calls Timed: " << callCount << " Alloc, " << callCount << " Free" << std::endl;
+	std::cout << "Average Alloc Time: " << allocTotal / callCount * 1000000.0 << " ns" << std::endl;
+	std::cout << "Min Alloc Time: " << allocMin * 1000000.0 << " ns" << std::endl;
+	std::cout << "Max Alloc Time: " << allocMax * 1000000.0 << " ns" << std::endl;
+	std::cout << "Average Free Time: " << freeTotal / callCount * 1000000.0 << " ns" << std::endl;
+	std::cout << "Min Free Time: " << freeMin * 1000000.0 << " ns" << std::endl;
+	std::cout << "Max Free Time: " << freeMax * 1000000.0 << " ns" << std::endl;
 }
 
 /*
-	Runs a particle system of its own.
+	Same simulation as PoolTestUnthreaded, but particles are referenced through 32-bit
+	handles into a HandlePool instead of through pointers.
 */
-template <typename T>
-void PoolTestTask(T& allocator, int tid, std::mutex& coutmtx, bool custom)
+void PoolTestHandles()
 {
-	std::stringstream ss;
-	ss << "pool_threaded_" << (custom ? "custom" : "default") << "_" << tid << ".csv";
+	typedef HandlePool<Particle>::Handle Handle;
 
 	std::fstream file;
-	file.open(ss.str(), std::ios_base::trunc | std::ios_base::out);
+	file.open("pool_unthreaded_handles.csv", std::ios_base::trunc | std::ios_base::out);
 	PoolTestWriteCaptions(file);
+	PerfCounters counters;
 
-	// Setup particle list and free-index list.
-	size_t freeList[POOL_TEST_THREADED_PARTICLE_COUNT];
-	Particle* particles[POOL_TEST_THREADED_PARTICLE_COUNT];
+	HandlePool<Particle> pool(POOL_TEST_PARTICLE_COUNT);
 
-	for(unsigned i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
-		freeList[i] = i;
+	Timer frameTimer;
+	bool running = true;
+	
+	size_t freeList[POOL_TEST_PARTICLE_COUNT];
+	Handle particles[POOL_TEST_PARTICLE_COUNT];
 
-	int freeListIndex = POOL_TEST_THREADED_PARTICLE_COUNT - 1;
+	for(unsigned i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+	{
+		freeList[i] = i;
+		particles[i] = HandlePool<Particle>::INVALID_HANDLE;
+	}
 
-	Timer timer;
+	int freeListIndex = POOL_TEST_PARTICLE_COUNT - 1;
 	int frameCount = 0;
-	double totalTime = 0.0;
-	double minTime = +100000000.0;
-	double maxTime = -100000000.0;
+	FrameStats stats;
 
-	// Start the simulation
-	bool running = true;
 	while (running)
 	{
 		int creations = 0;
 		int deletions = 0;
 
-		timer.Start();
+		// Start timing
+		counters.Start();
+		frameTimer.Start();
 
 		// Allocate particle objects
-		while (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT && freeListIndex != -1)
+		while (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT && freeListIndex != -1)
 		{
 			creations++;
 
-			int lifetime = RNDThreaded[freeList[freeListIndex]];
-			Particle* p = new(allocator.Alloc()) Particle(lifetime);
+			int lifetime = RND[freeList[freeListIndex]];
+			Handle handle = pool.Alloc();
+			new(pool.Get(handle)) Particle(lifetime);
 			
-			particles[freeList[freeListIndex--]] = p;
+			particles[freeList[freeListIndex--]] = handle;
 		}
 
 		// Update simulation of particles (increase lived time)
 		// Deallocate dead particle objects.
-		for (size_t i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
+		for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
 		{
-			Particle*& particle = particles[i];
+			Handle& handle = particles[i];
+			Particle* particle = pool.Get(handle);
 
 			if(particle != nullptr)
 			{
@@ -315,194 +669,1003 @@ void PoolTestTask(T& allocator, int tid, std::mutex& coutmtx, bool custom)
 				{
 					deletions++;
 
-					allocator.Free(particle);
+					pool.Free(handle);
+					assert(pool.Get(handle) == nullptr && "Stale handle still resolves");
 
-					particle = nullptr;
+					handle = HandlePool<Particle>::INVALID_HANDLE;
 					freeList[++freeListIndex] = i;
 				}
 			}
 		}
 
 		// Check if all are dead and terminate.
-		running = (freeListIndex != POOL_TEST_THREADED_PARTICLE_COUNT - 1)  || (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT);
-
-		double elapsed = timer.Stop();
-		frameCount++;
-		totalTime += elapsed;
-
-		if (elapsed < minTime)
-			minTime = elapsed;
-		if (elapsed > maxTime)
-			maxTime = elapsed;
+		running = (freeListIndex != POOL_TEST_PARTICLE_COUNT - 1) || (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT);
 
-		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle));
-	}
+		// Measure time.
+		double elapsed = frameTimer.Stop();
+		counters.Stop();
 
-	std::lock_guard<std::mutex> lock(coutmtx);
-	std::cout << "Thread " << tid << std::endl;
-	std::cout << "\tFrames Simulated: " << frameCount << std::endl;
-	std::cout << "\tTotal Experiment Time: " << totalTime << std::endl;
-	std::cout << "\tAverage Frame Time: " << totalTime / frameCount << std::endl;
-	std::cout << "\tMin Frame Time: " << minTime << std::endl;
-	std::cout << "\tMax Frame Time: " << maxTime << std::endl;
-}
+		stats.Add(elapsed);
 
-void MultiplePoolTestThreaded()
-{
-	std::mutex coutmtx;
-	std::vector<std::thread> workers;
-	workers.reserve(POOL_TEST_THREADED_WORKER_COUNT);
+		// Store profiling data.
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
 
-	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
-	{
-		workers.push_back(std::thread(MultiplePoolTestTask, k, std::ref(coutmtx)));
+		frameCount++;
 	}
 
-	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
-	{
-		workers[k].join();
-	}
+	std::cout << "Frames Simulated: " << frameCount << std::endl;
+	std::cout << "Total Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print();
+	PoolTestPrintCounters(counters, frameCount);
+	std::cout << "Reference Array Size: " << sizeof(particles) << " bytes (pointers: " << sizeof(Particle*) * POOL_TEST_PARTICLE_COUNT << " bytes)" << std::endl;
 }
 
-void MultiplePoolTestTask( int tid, std::mutex& coutmtx)
+/*
+	Same simulation as PoolTestUnthreaded on a DensePool. The update walks only the live
+	particles, which are packed at the front of the pool, instead of every slot.
+*/
+void PoolTestDense()
 {
-	std::stringstream ss;
-	ss << "multiple_pool_threaded_custom_" << tid << ".csv";
-
 	std::fstream file;
-	file.open(ss.str(), std::ios_base::trunc | std::ios_base::out);
-	
+	file.open("pool_unthreaded_dense.csv", std::ios_base::trunc | std::ios_base::out);
 	PoolTestWriteCaptions(file);
+	PerfCounters counters;
 
-	PoolAllocator allocator(sizeof(Particle), POOL_TEST_THREADED_PARTICLE_COUNT);
-
-	// Setup particle list and free-index list.
-	size_t freeList[POOL_TEST_THREADED_PARTICLE_COUNT];
-	Particle* particles[POOL_TEST_THREADED_PARTICLE_COUNT];
-
-	for(unsigned i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
-		freeList[i] = i;
+	DensePool<Particle> pool(POOL_TEST_PARTICLE_COUNT);
 
-	int freeListIndex = POOL_TEST_THREADED_PARTICLE_COUNT - 1;
+	Timer frameTimer;
+	bool running = true;
 
-	Timer timer;
 	int frameCount = 0;
-	double totalTime = 0.0;
-	double minTime = +100000000.0;
-	double maxTime = -100000000.0;
+	FrameStats stats;
 
-	// Start the simulation
-	bool running = true;
 	while (running)
 	{
 		int creations = 0;
 		int deletions = 0;
 
-		timer.Start();
+		// Start timing
+		counters.Start();
+		frameTimer.Start();
 
 		// Allocate particle objects
-		while (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT && freeListIndex != -1)
+		while (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT && pool.GetCount() != pool.GetCapacity())
 		{
 			creations++;
 
-			int lifetime = RNDThreaded[freeList[freeListIndex]];
-			Particle* p = new(allocator.Alloc()) Particle(lifetime);
-			
-			particles[freeList[freeListIndex--]] = p;
+			DensePool<Particle>::Id id;
+			void* storage = pool.Alloc(id);
+			new(storage) Particle(RND[id]);
 		}
 
-		// Update simulation of particles (increase lived time)
+		// Update simulation of the live particles (increase lived time)
 		// Deallocate dead particle objects.
-		for (size_t i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
+		Particle* particles = pool.GetData();
+		for (unsigned i = 0; i < pool.GetCount(); )
 		{
-			Particle*& particle = particles[i];
+			particles[i].framesLeftToLive--;
 
-			if(particle != nullptr)
+			if (particles[i].framesLeftToLive <= 0)
 			{
-				particle->framesLeftToLive--;
-
-				if (particle->framesLeftToLive <= 0)
-				{
-					deletions++;
-
-					allocator.Free(particle);
+				deletions++;
 
-					particle = nullptr;
-					freeList[++freeListIndex] = i;
-				}
+				// The last live particle moves into i, update it next.
+				pool.FreeAt(i);
+			}
+			else
+			{
+				++i;
 			}
 		}
 
 		// Check if all are dead and terminate.
-		running = (freeListIndex != POOL_TEST_THREADED_PARTICLE_COUNT - 1)  || (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT);
+		running = (pool.GetCount() != 0) || (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT);
 
-		double elapsed = timer.Stop();
-		frameCount++;
-		totalTime += elapsed;
+		// Measure time.
+		double elapsed = frameTimer.Stop();
+		counters.Stop();
 
-		if (elapsed < minTime)
-			minTime = elapsed;
-		if (elapsed > maxTime)
-			maxTime = elapsed;
+		stats.Add(elapsed);
+
+		// Store profiling data.
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
 
-		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle));
+		frameCount++;
+	}
+
+	std::cout << "Frames Simulated: " << frameCount << std::endl;
+	std::cout << "Total Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print();
+	PoolTestPrintCounters(counters, frameCount);
+}
+
+/*
+	Same simulation as PoolTestUnthreaded on a BitmapPool. The update walks the live set
+	bits in address order instead of a particle pointer array.
+*/
+void PoolTestBitmap()
+{
+	std::fstream file;
+	file.open("pool_unthreaded_bitmap.csv", std::ios_base::trunc | std::ios_base::out);
+	PoolTestWriteCaptions(file);
+	PerfCounters counters;
+
+	BitmapPool pool(sizeof(Particle), POOL_TEST_PARTICLE_COUNT);
+
+	Timer frameTimer;
+	bool running = true;
+
+	int frameCount = 0;
+	FrameStats stats;
+
+	while (running)
+	{
+		int creations = 0;
+		int deletions = 0;
+
+		// Start timing
+		counters.Start();
+		frameTimer.Start();
+
+		// Allocate particle objects
+		while (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT && pool.GetCount() != pool.GetCapacity())
+		{
+			creations++;
+
+			void* storage = pool.Alloc();
+			new(storage) Particle(RND[pool.GetIndex(storage)]);
+		}
+
+		// Update simulation of the live particles (increase lived time)
+		// Deallocate dead particle objects.
+		pool.ForEach([&](void* element)
+		{
+			Particle* particle = (Particle*)element;
+			particle->framesLeftToLive--;
+
+			if (particle->framesLeftToLive <= 0)
+			{
+				deletions++;
+				pool.Free(particle);
+			}
+		});
+
+		// Check if all are dead and terminate.
+		running = (pool.GetCount() != 0) || (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT);
+
+		// Measure time.
+		double elapsed = frameTimer.Stop();
+		counters.Stop();
+
+		stats.Add(elapsed);
+
+		// Store profiling data.
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
+
+		frameCount++;
+	}
+
+	std::cout << "Frames Simulated: " << frameCount << std::endl;
+	std::cout << "Total Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print();
+	PoolTestPrintCounters(counters, frameCount);
+}
+
+/*
+	Same simulation as PoolTestUnthreaded with particles split into a packed lifetime array
+	and pooled payloads. Lifetimes are updated with SIMD and dead particles compacted away.
+*/
+void PoolTestSoA()
+{
+	std::fstream file;
+	file.open("pool_unthreaded_soa.csv", std::ios_base::trunc | std::ios_base::out);
+	PoolTestWriteCaptions(file);
+	PerfCounters counters;
+
+	ParticleSoA particles(POOL_TEST_PARTICLE_COUNT, sizeof(Particle::data));
+	unsigned dead[POOL_TEST_PARTICLE_COUNT];
+
+	Timer frameTimer;
+	bool running = true;
+
+	size_t spawned = 0;
+	int frameCount = 0;
+	FrameStats stats;
+
+	while (running)
+	{
+		int creations = 0;
+		int deletions = 0;
+
+		// Start timing
+		counters.Start();
+		frameTimer.Start();
+
+		// Allocate particle objects
+		while (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT && particles.GetCount() != particles.GetCapacity())
+		{
+			creations++;
+
+			particles.Spawn(RND[spawned++ % POOL_TEST_PARTICLE_COUNT]);
+		}
+
+		// Update simulation of particles (increase lived time)
+		// Deallocate dead particle objects.
+		unsigned deadCount = particles.UpdateLifetimes(dead);
+		particles.Compact(dead, deadCount);
+		deletions += deadCount;
+
+		// Check if all are dead and terminate.
+		running = (particles.GetCount() != 0) || (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT);
+
+		// Measure time.
+		double elapsed = frameTimer.Stop();
+		counters.Stop();
+
+		stats.Add(elapsed);
+
+		// Store profiling data.
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
+
+		frameCount++;
+	}
+
+	std::cout << "Frames Simulated: " << frameCount << std::endl;
+	std::cout << "Total Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print();
+	PoolTestPrintCounters(counters, frameCount);
+}
+
+/*
+	Same simulation as PoolTestUnthreaded with the update split across workerCount workers
+	of a JobSystem. The particle array is cut into ranges of whole cache lines so no two
+	jobs write to the same line. Each job collects its dead particles into the list of the
+	worker running it, and the main thread merges the lists into one FreeN per frame.
+*/
+template <typename T>
+void PoolTestParallel(T& allocator, unsigned int workerCount, const char* name)
+{
+	std::stringstream ss;
+	ss << "pool_parallel_" << name << ".csv";
+
+	std::fstream file;
+	file.open(ss.str(), std::ios_base::trunc | std::ios_base::out);
+	PoolTestWriteCaptions(file);
+	PerfCounters counters;
+
+	JobSystem jobs(workerCount - 1);
+	unsigned int mainWorker = jobs.GetMainWorker();
+	std::vector<PoolTestDeadList> deadLists(jobs.GetWorkerCount());
+
+	// Cache line aligned particle array.
+	std::vector<char> particleStorage(POOL_TEST_PARTICLE_COUNT * sizeof(Particle*) + POOL_TEST_CACHE_LINE_SIZE);
+	Particle** particles = (Particle**)(((uintptr_t)&particleStorage[0] + POOL_TEST_CACHE_LINE_SIZE - 1) & ~(uintptr_t)(POOL_TEST_CACHE_LINE_SIZE - 1));
+	for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+		particles[i] = nullptr;
+
+	// Split the array into ranges rounded up to whole cache lines.
+	const size_t particlesPerLine = POOL_TEST_CACHE_LINE_SIZE / sizeof(Particle*);
+	size_t rangeCount = workerCount * POOL_TEST_PARALLEL_RANGES_PER_WORKER;
+	size_t rangeSize = (POOL_TEST_PARTICLE_COUNT + rangeCount - 1) / rangeCount;
+	rangeSize = (rangeSize + particlesPerLine - 1) / particlesPerLine * particlesPerLine;
+
+	std::vector<PoolTestRange> ranges;
+	for (size_t begin = 0; begin < POOL_TEST_PARTICLE_COUNT; begin += rangeSize)
+	{
+		PoolTestRange range;
+		range.particles = particles;
+		range.begin = begin;
+		range.end = std::min(begin + rangeSize, POOL_TEST_PARTICLE_COUNT);
+		range.deadLists = &deadLists[0];
+		ranges.push_back(range);
+	}
+
+	Timer frameTimer;
+	bool running = true;
+
+	size_t freeList[POOL_TEST_PARTICLE_COUNT];
+	void* spawnBatch[POOL_TEST_PARTICLE_COUNT];
+	void* deadBatch[POOL_TEST_PARTICLE_COUNT];
+
+	for(unsigned i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+		freeList[i] = i;
+
+	int freeListIndex = POOL_TEST_PARTICLE_COUNT - 1;
+	int frameCount = 0;
+	FrameStats stats;
+
+	while (running)
+	{
+		int creations = 0;
+		int deletions = 0;
+
+		PROFILE_FLUSH();
+
+		// Start timing
+		counters.Start();
+		frameTimer.Start();
+		PROFILE_ZONE("Pool Frame");
+
+		// Allocate particle objects, the whole frame's spawns in one batch.
+		if (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT && freeListIndex != -1)
+		{
+			PROFILE_ZONE("Spawn");
+			unsigned spawnCount = allocator.AllocN(spawnBatch, freeListIndex + 1);
+
+			for (unsigned k = 0; k < spawnCount; ++k)
+			{
+				creations++;
+
+				int lifetime = RND[freeList[freeListIndex]];
+				Particle* p = new(spawnBatch[k]) Particle(lifetime);
+
+				particles[freeList[freeListIndex--]] = p;
+			}
+		}
+
+		// Update simulation of particles on all workers.
+		{
+			PROFILE_ZONE("Update");
+			for (size_t k = 0; k < deadLists.size(); ++k)
+				deadLists[k].count = 0;
+
+			for (size_t k = 0; k < ranges.size(); ++k)
+				jobs.Submit(mainWorker, PoolTestParallelUpdate, &ranges[k]);
+
+			jobs.WaitFrame();
+		}
+
+		// Merge the dead lists and return the frame's dead particles in one batch.
+		for (size_t k = 0; k < deadLists.size(); ++k)
+		{
+			PoolTestDeadList& dead = deadLists[k];
+			for (size_t i = 0; i < dead.count; ++i)
+			{
+				deadBatch[deletions++] = dead.particles[i];
+				freeList[++freeListIndex] = dead.slots[i];
+			}
+		}
+
+		{
+			PROFILE_ZONE("Free");
+			allocator.FreeN(deadBatch, deletions);
+		}
+
+		// Check if all are dead and terminate.
+		running = (freeListIndex != POOL_TEST_PARTICLE_COUNT - 1) || (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT);
+
+		// Measure time.
+		double elapsed = frameTimer.Stop();
+		counters.Stop();
+
+		stats.Add(elapsed);
+
+		// Store profiling data.
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
+
+		frameCount++;
+	}
+
+	std::cout << "Frames Simulated: " << frameCount << std::endl;
+	std::cout << "Total Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print();
+	PoolTestPrintCounters(counters, frameCount);
+	std::cout << "Ranges Per Frame: " << ranges.size() << " of " << rangeSize << " particles" << std::endl;
+	std::cout << "Steals Per Frame: " << (double)jobs.GetStealCount() / frameCount << std::endl;
+}
+
+/*
+	Updates one range of a PoolTestParallel frame. Dead particles are cleared from the
+	array and recorded in the running worker's dead list.
+*/
+void PoolTestParallelUpdate(void* data, unsigned int worker)
+{
+	PROFILE_ZONE("Update Range");
+	PoolTestRange* range = (PoolTestRange*)data;
+	PoolTestDeadList& dead = range->deadLists[worker];
+
+	for (size_t i = range->begin; i < range->end; ++i)
+	{
+		Particle*& particle = range->particles[i];
+
+		if (particle != nullptr)
+		{
+			particle->framesLeftToLive--;
+
+			if (particle->framesLeftToLive <= 0)
+			{
+				dead.particles[dead.count] = particle;
+				dead.slots[dead.count] = i;
+				dead.count++;
+
+				particle = nullptr;
+			}
+		}
+	}
+}
+
+template <typename T>
+void PoolTestThreaded(T& allocator, const char* name)
+{
+	std::mutex coutmtx;
+	std::vector<std::thread> workers;
+	workers.reserve(POOL_TEST_THREADED_WORKER_COUNT);
+
+	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
+	{
+		workers.push_back(std::thread(PoolTestTask<T>, std::ref(allocator), k, std::ref(coutmtx), name));
+	}
+
+	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
+	{
+		workers[k].join();
+	}
+}
+
+/*
+	Runs a particle system of its own.
+*/
+template <typename T>
+void PoolTestTask(T& allocator, int tid, std::mutex& coutmtx, const char* name)
+{
+	PROFILE_THREAD_INDEX("Pool Test Thread", tid);
+
+	std::stringstream ss;
+	ss << "pool_threaded_" << name << "_" << tid << ".csv";
+
+	std::fstream file;
+	file.open(ss.str(), std::ios_base::trunc | std::ios_base::out);
+	PoolTestWriteCaptions(file);
+	PerfCounters counters;
+
+	// Setup particle list and free-index list.
+	size_t freeList[POOL_TEST_THREADED_PARTICLE_COUNT];
+	Particle* particles[POOL_TEST_THREADED_PARTICLE_COUNT];
+	void* spawnBatch[POOL_TEST_THREADED_PARTICLE_COUNT];
+	void* deadBatch[POOL_TEST_THREADED_PARTICLE_COUNT];
+
+	for(unsigned i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
+	{
+		freeList[i] = i;
+		particles[i] = nullptr;
+	}
+
+	int freeListIndex = POOL_TEST_THREADED_PARTICLE_COUNT - 1;
+
+	Timer timer;
+	int frameCount = 0;
+	FrameStats stats;
+
+	// Start the simulation
+	bool running = true;
+	while (running)
+	{
+		int creations = 0;
+		int deletions = 0;
+
+		PROFILE_FLUSH();
+
+		counters.Start();
+		timer.Start();
+		PROFILE_ZONE("Pool Frame");
+
+		// Allocate particle objects, the whole frame's spawns in one batch.
+		if (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT && freeListIndex != -1)
+		{
+			PROFILE_ZONE("Spawn");
+			unsigned spawnCount = allocator.AllocN(spawnBatch, freeListIndex + 1);
+
+			for (unsigned k = 0; k < spawnCount; ++k)
+			{
+				creations++;
+
+				int lifetime = RNDThreaded[freeList[freeListIndex]];
+				Particle* p = new(spawnBatch[k]) Particle(lifetime);
+
+				particles[freeList[freeListIndex--]] = p;
+			}
+		}
+
+		// Update simulation of particles (increase lived time)
+		// Deallocate dead particle objects.
+		{
+			PROFILE_ZONE("Update");
+			for (size_t i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
+			{
+				Particle*& particle = particles[i];
+
+				if(particle != nullptr)
+				{
+					particle->framesLeftToLive--;
+
+					if (particle->framesLeftToLive <= 0)
+					{
+						deadBatch[deletions++] = particle;
+
+						particle = nullptr;
+						freeList[++freeListIndex] = i;
+					}
+				}
+			}
+		}
+
+		// Return the frame's dead particles in one batch.
+		{
+			PROFILE_ZONE("Free");
+			allocator.FreeN(deadBatch, deletions);
+		}
+
+		// Check if all are dead and terminate.
+		running = (freeListIndex != POOL_TEST_THREADED_PARTICLE_COUNT - 1)  || (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT);
+
+		double elapsed = timer.Stop();
+		counters.Stop();
+		frameCount++;
+
+		stats.Add(elapsed);
+
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
+	}
+
+	std::lock_guard<std::mutex> lock(coutmtx);
+	std::cout << "Thread " << tid << std::endl;
+	std::cout << "\tFrames Simulated: " << frameCount << std::endl;
+	std::cout << "\tTotal Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print("\t");
+	PoolTestPrintCounters(counters, frameCount, "\t");
+}
+
+/*
+	Measures the construction time of a particle pool and how much of it is resident
+	right after construction and after an eighth of it has been used.
+*/
+void PoolInitTest(PoolInit init)
+{
+	Timer timer;
+	size_t residentBefore = ProcessStats::GetResidentMemory();
+
+	timer.Start();
+	PoolAllocator* pool = new PoolAllocator(sizeof(Particle), POOL_TEST_PARTICLE_COUNT, POOL_GROWTH_NONE, 0, init);
+	double elapsed = timer.Stop();
+
+	size_t residentConstructed = ProcessStats::GetResidentMemory();
+
+	std::vector<void*> used(POOL_TEST_PARTICLE_COUNT / 8);
+	for (size_t i = 0; i < used.size(); ++i)
+		used[i] = new(pool->Alloc()) Particle(1);
+
+	size_t residentUsed = ProcessStats::GetResidentMemory();
+
+	for (size_t i = 0; i < used.size(); ++i)
+		pool->Free(used[i]);
+	delete pool;
+
+	std::cout << "Construction Time: " << elapsed << std::endl;
+	std::cout << "Resident After Construction: " << (residentConstructed - residentBefore) / 1024 << " KB" << std::endl;
+	std::cout << "Resident After Using 1/8: " << (residentUsed - residentBefore) / 1024 << " KB" << std::endl;
+}
+
+/*
+	Runs the unthreaded pool test on a lazily initialized pool taking its memory from store,
+	so first-touch page faults land inside the timed frames unless the store prefaults.
+*/
+void PoolBackingTest(BackingStore& store, const char* name)
+{
+	PoolAllocator pool(sizeof(Particle), POOL_TEST_PARTICLE_COUNT, POOL_GROWTH_NONE, 0, POOL_INIT_LAZY, &store);
+
+	size_t faultsBefore = ProcessStats::GetPageFaultCount();
+	PoolTestUnthreaded(pool, name);
+	size_t faults = ProcessStats::GetPageFaultCount() - faultsBefore;
+
+	std::cout << "Page Faults: " << faults << std::endl;
+}
+
+/*
+	Spawn spike followed by a long quiet period on a ChunkedPoolAllocator.
+
+	The first POOL_TEST_SPAWN_FRAME_LIMIT frames keep the pool full like PoolTestUnthreaded,
+	then only POOL_TEST_RELEASE_TRICKLE_COUNT particles are kept alive for another
+	POOL_TEST_RELEASE_IDLE_FRAMES frames. Resident memory is sampled along the way to show
+	whether the pages of the spike are handed back.
+*/
+void PoolReleaseTest(ChunkRelease release, const char* name)
+{
+	std::stringstream ss;
+	ss << "pool_unthreaded_" << name << ".csv";
+
+	std::fstream file;
+	file.open(ss.str(), std::ios_base::trunc | std::ios_base::out);
+	PoolTestWriteCaptions(file);
+	PerfCounters counters;
+
+	size_t residentBefore = ProcessStats::GetResidentMemory();
+
+	ChunkedPoolAllocator pool(sizeof(Particle), POOL_TEST_PARTICLE_COUNT, POOL_TEST_RELEASE_CHUNK_SIZE, release);
+
+	size_t freeList[POOL_TEST_PARTICLE_COUNT];
+	Particle* particles[POOL_TEST_PARTICLE_COUNT];
+
+	for(unsigned i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+	{
+		freeList[i] = i;
+		particles[i] = nullptr;
+	}
+
+	Timer frameTimer;
+	int freeListIndex = POOL_TEST_PARTICLE_COUNT - 1;
+	int frameCount = 0;
+	FrameStats stats;
+
+	while (frameCount < POOL_TEST_SPAWN_FRAME_LIMIT + POOL_TEST_RELEASE_IDLE_FRAMES)
+	{
+		int creations = 0;
+		int deletions = 0;
+
+		counters.Start();
+		frameTimer.Start();
+
+		// Keep the pool full during the spike, then only a trickle alive.
+		int live = POOL_TEST_PARTICLE_COUNT - 1 - freeListIndex;
+		int target = frameCount < POOL_TEST_SPAWN_FRAME_LIMIT ? POOL_TEST_PARTICLE_COUNT : POOL_TEST_RELEASE_TRICKLE_COUNT;
+
+		for (; live < target; ++live)
+		{
+			creations++;
+
+			int lifetime = RND[freeList[freeListIndex]];
+			particles[freeList[freeListIndex--]] = new(pool.Alloc()) Particle(lifetime);
+		}
+
+		// Update simulation of particles (increase lived time)
+		// Deallocate dead particle objects.
+		for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+		{
+			Particle*& particle = particles[i];
+
+			if(particle != nullptr)
+			{
+				particle->framesLeftToLive--;
+
+				if (particle->framesLeftToLive <= 0)
+				{
+					deletions++;
+
+					pool.Free(particle);
+
+					particle = nullptr;
+					freeList[++freeListIndex] = i;
+				}
+			}
+		}
+
+		pool.Tick();
+
+		double elapsed = frameTimer.Stop();
+		counters.Stop();
+
+		stats.Add(elapsed);
+
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
+
+		frameCount++;
+
+		if (frameCount % POOL_TEST_RELEASE_SAMPLE_INTERVAL == 0)
+		{
+			std::cout << "Frame " << frameCount << ": Resident " << (ProcessStats::GetResidentMemory() - residentBefore) / 1024 << " KB, Committed " << pool.GetCommittedSize() / 1024 << " KB" << std::endl;
+		}
+	}
+
+	for (size_t i = 0; i < POOL_TEST_PARTICLE_COUNT; ++i)
+	{
+		if (particles[i] != nullptr)
+			pool.Free(particles[i]);
+	}
+
+	stats.Print();
+	PoolTestPrintCounters(counters, frameCount);
+	std::cout << "Chunks Released: " << pool.GetReleaseCount() << ", Reused After Release: " << pool.GetRecommitCount() << std::endl;
+}
+
+/*
+	Runs the threaded pool test with a per-thread magazine cache in front of the shared pool.
+*/
+void PoolTestThreadedMagazine(MagazinePoolAllocator& allocator)
+{
+	std::mutex coutmtx;
+	std::vector<std::thread> workers;
+	workers.reserve(POOL_TEST_THREADED_WORKER_COUNT);
+
+	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
+	{
+		workers.push_back(std::thread(PoolTestMagazineTask, std::ref(allocator), k, std::ref(coutmtx)));
+	}
+
+	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
+	{
+		workers[k].join();
+	}
+}
+
+void PoolTestMagazineTask(MagazinePoolAllocator& allocator, int tid, std::mutex& coutmtx)
+{
+	PoolMagazine magazine(allocator, POOL_TEST_MAGAZINE_CAPACITY);
+
+	PoolTestTask(magazine, tid, coutmtx, "magazine");
+
+	std::lock_guard<std::mutex> lock(coutmtx);
+	std::cout << "\tThread " << tid << " Cache Hit Rate: " << magazine.GetHitRate() * 100.0 << "%" << std::endl;
+}
+
+inline void PoolTestRemoteFree(ThreadedPoolAllocator& allocator, void* ptr) { allocator.Free(ptr); }
+inline void PoolTestRemoteFree(OwnerPoolAllocator& allocator, void* ptr) { allocator.RemoteFree(ptr); }
+
+/*
+	Particles allocated on one thread and freed on another.
+
+	The main thread spawns POOL_TEST_PRODUCER_SPAWN_COUNT particles per frame and hands
+	them to a consumer thread, which frees them one by one during the following frames.
+	The producer frame and the consumer's free loop are timed separately.
+*/
+template <typename T>
+void PoolTestProducerConsumer(T& allocator)
+{
+	Timer timer;
+	FrameTestQueue queue;
+	queue.produced = -1;
+	queue.consumed = -1;
+
+	double freeTime = 0.0;
+	std::thread consumer(PoolTestConsumer<T>, std::ref(allocator), std::ref(queue), std::ref(freeTime));
+
+	FrameStats stats;
+
+	for (size_t k = 0; k < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT; ++k)
+	{
+		// The particle list of this slot must have been consumed. Waiting on the
+		// consumer is not part of the producer frame.
+		while (queue.consumed.load() < (long long)k - (long long)FRAME_TEST_RING_SIZE)
+			std::this_thread::yield();
+
+		timer.Start();
+
+		std::vector<void*>& particles = queue.blocks[k % FRAME_TEST_RING_SIZE];
+		particles.resize(POOL_TEST_PRODUCER_SPAWN_COUNT);
+
+		for (size_t i = 0; i < POOL_TEST_PRODUCER_SPAWN_COUNT; ++i)
+		{
+			void* ptr = allocator.Alloc();
+			assert(ptr != nullptr && "Pool exhausted, consumer frees were lost");
+
+			particles[i] = new(ptr) Particle(RNDThreaded[i]);
+		}
+
+		queue.produced.store(k);
+
+		double elapsed = timer.Stop();
+		stats.Add(elapsed);
+	}
+
+	consumer.join();
+
+	std::cout << "Frames Simulated: " << stats.frameCount << std::endl;
+	stats.Print();
+	std::cout << "Average Consumer Free Time: " << freeTime / stats.frameCount << std::endl;
+}
+
+template <typename T>
+void PoolTestConsumer(T& allocator, FrameTestQueue& queue, double& freeTime)
+{
+	Timer timer;
+
+	for (long long k = 0; k < (long long)POOL_TEST_THREADED_SPAWN_FRAME_LIMIT; ++k)
+	{
+		while (queue.produced.load() < k)
+			std::this_thread::yield();
+
+		std::vector<void*>& particles = queue.blocks[k % FRAME_TEST_RING_SIZE];
+
+		timer.Start();
+		for (size_t i = 0; i < particles.size(); ++i)
+		{
+			assert(((Particle*)particles[i])->framesLeftToLive == RNDThreaded[i] && "Particle overwritten before it was consumed");
+			PoolTestRemoteFree(allocator, particles[i]);
+		}
+		freeTime += timer.Stop();
+
+		queue.consumed.store(k);
+	}
+}
+
+void MultiplePoolTestThreaded()
+{
+	std::mutex coutmtx;
+	std::vector<std::thread> workers;
+	workers.reserve(POOL_TEST_THREADED_WORKER_COUNT);
+
+	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
+	{
+		workers.push_back(std::thread(MultiplePoolTestTask, k, std::ref(coutmtx)));
+	}
+
+	for (int k = 0; k < POOL_TEST_THREADED_WORKER_COUNT; ++k)
+	{
+		workers[k].join();
+	}
+}
+
+void MultiplePoolTestTask( int tid, std::mutex& coutmtx)
+{
+	std::stringstream ss;
+	ss << "multiple_pool_threaded_custom_" << tid << ".csv";
+
+	std::fstream file;
+	file.open(ss.str(), std::ios_base::trunc | std::ios_base::out);
+	
+	PoolTestWriteCaptions(file);
+	PerfCounters counters;
+
+	PoolAllocator allocator(sizeof(Particle), POOL_TEST_THREADED_PARTICLE_COUNT);
+
+	// Setup particle list and free-index list.
+	size_t freeList[POOL_TEST_THREADED_PARTICLE_COUNT];
+	Particle* particles[POOL_TEST_THREADED_PARTICLE_COUNT];
+	void* spawnBatch[POOL_TEST_THREADED_PARTICLE_COUNT];
+	void* deadBatch[POOL_TEST_THREADED_PARTICLE_COUNT];
+
+	for(unsigned i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
+	{
+		freeList[i] = i;
+		particles[i] = nullptr;
+	}
+
+	int freeListIndex = POOL_TEST_THREADED_PARTICLE_COUNT - 1;
+
+	Timer timer;
+	int frameCount = 0;
+	FrameStats stats;
+
+	// Start the simulation
+	bool running = true;
+	while (running)
+	{
+		int creations = 0;
+		int deletions = 0;
+
+		counters.Start();
+		timer.Start();
+
+		// Allocate particle objects, the whole frame's spawns in one batch.
+		if (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT && freeListIndex != -1)
+		{
+			unsigned spawnCount = allocator.AllocN(spawnBatch, freeListIndex + 1);
+
+			for (unsigned k = 0; k < spawnCount; ++k)
+			{
+				creations++;
+
+				int lifetime = RNDThreaded[freeList[freeListIndex]];
+				Particle* p = new(spawnBatch[k]) Particle(lifetime);
+
+				particles[freeList[freeListIndex--]] = p;
+			}
+		}
+
+		// Update simulation of particles (increase lived time)
+		// Deallocate dead particle objects.
+		for (size_t i = 0; i < POOL_TEST_THREADED_PARTICLE_COUNT; ++i)
+		{
+			Particle*& particle = particles[i];
+
+			if(particle != nullptr)
+			{
+				particle->framesLeftToLive--;
+
+				if (particle->framesLeftToLive <= 0)
+				{
+					deadBatch[deletions++] = particle;
+
+					particle = nullptr;
+					freeList[++freeListIndex] = i;
+				}
+			}
+		}
+
+		// Return the frame's dead particles in one batch.
+		allocator.FreeN(deadBatch, deletions);
+
+		// Check if all are dead and terminate.
+		running = (freeListIndex != POOL_TEST_THREADED_PARTICLE_COUNT - 1)  || (frameCount < POOL_TEST_THREADED_SPAWN_FRAME_LIMIT);
+
+		double elapsed = timer.Stop();
+		counters.Stop();
+		frameCount++;
+
+		stats.Add(elapsed);
+
+		PoolTestWriteFrameData(file, frameCount, elapsed, creations, deletions, creations * sizeof(Particle), counters);
 	}
 
 	std::lock_guard<std::mutex> lock(coutmtx);
 	std::cout << "Thread " << tid << std::endl;
 	std::cout << "\tFrames Simulated: " << frameCount << std::endl;
-	std::cout << "\tTotal Experiment Time: " << totalTime << std::endl;
-	std::cout << "\tAverage Frame Time: " << totalTime / frameCount << std::endl;
-	std::cout << "\tMin Frame Time: " << minTime << std::endl;
-	std::cout << "\tMax Frame Time: " << maxTime << std::endl;
+	std::cout << "\tTotal Experiment Time: " << stats.totalTime << std::endl;
+	stats.Print("\t");
+	PoolTestPrintCounters(counters, frameCount, "\t");
 }
 
 void PoolTestWriteCaptions(std::fstream& file)
 {
-	file << "Frame; Time; Creations; Deletions; Allocation Size" << std::endl;
+	file << "Frame; Time; Creations; Deletions; Allocation Size";
+	for (unsigned i = 0; i < PERF_COUNTER_COUNT; ++i)
+		file << "; " << PerfCounters::GetName((PerfCounter)i);
+	file << std::endl;
 }
 
-void PoolTestWriteFrameData(std::fstream& file, int frameNumber, double elapsed, int creations, int deletions, int allocationSize)
+// Counters that are unavailable are left empty.
+void PoolTestWriteFrameData(std::fstream& file, int frameNumber, double elapsed, int creations, int deletions, int allocationSize, const PerfCounters& counters)
 {
-	file << frameNumber << "; " << elapsed << "; " << creations << "; " << deletions << "; " << creations * sizeof(Particle) << std::endl;
+	file << frameNumber << "; " << elapsed << "; " << creations << "; " << deletions << "; " << creations * sizeof(Particle);
+	for (unsigned i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		file << "; ";
+		if (counters.IsAvailable((PerfCounter)i))
+			file << counters.GetFrame().values[i];
+	}
+	file << std::endl;
+}
+
+void PoolTestPrintCounters(const PerfCounters& counters, int frameCount, const char* indent)
+{
+	const PerfSample& total = counters.GetTotal();
+	for (unsigned i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		if (counters.IsAvailable((PerfCounter)i))
+			std::cout << indent << PerfCounters::GetName((PerfCounter)i) << " Per Frame: " << (double)total.values[i] / frameCount << std::endl;
+	}
+
+	if (counters.IsAvailable(PERF_COUNTER_CYCLES) && counters.IsAvailable(PERF_COUNTER_INSTRUCTIONS) && total.values[PERF_COUNTER_CYCLES] != 0)
+		std::cout << indent << "Instructions Per Cycle: " << (double)total.values[PERF_COUNTER_INSTRUCTIONS] / total.values[PERF_COUNTER_CYCLES] << std::endl;
 }
 
 /*
 	Stack Test with custom memory manager.
 
-	This will spawn a number of worker threads that will simultaneously use the memory manager.
+	Every frame STACK_TEST_WORKER_COUNT jobs run on a persistent job system and use the
+	memory manager simultaneously. The calling thread is one of the workers.
+	Unless the stack is locked and unbuffered, jobs go through a StackThreadBuffer and
+	the bytes each of them wasted are reported.
 */
-double StackTestCustom()
+double StackTestCustom(StackSync sync, size_t bufferSize)
 {
 	Timer timer;
-	StackMemoryManager stack(STACK_TEST_WORKER_COUNT * STACK_TEST_OBJECTS_PER_WORKER * STACK_MAX_ALLOC_SIZE);
-	std::vector<std::thread> workers;
-	workers.reserve(STACK_TEST_WORKER_COUNT);
+	StackMemoryManager stack(STACK_TEST_WORKER_COUNT * STACK_TEST_OBJECTS_PER_WORKER * STACK_MAX_ALLOC_SIZE, sync);
+	JobSystem jobs(STACK_TEST_WORKER_COUNT - 1);
 
-	double totalTime = 0.0;
-	double minTime = +100000000.0;
-	double maxTime = -100000000.0;
-	int frameCount = 0;
+	bool buffered = sync != STACK_SYNC_MUTEX || bufferSize != 0;
+	std::vector<size_t> waste(STACK_TEST_WORKER_COUNT, 0);
+
+	std::vector<StackTestJob> jobData(STACK_TEST_WORKER_COUNT);
+	for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
+	{
+		jobData[i].stack = &stack;
+		jobData[i].bufferSize = bufferSize;
+		jobData[i].waste = &waste[i];
+	}
+
+	FrameStats stats;
 
 	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
 	{
 		// Start timing.
 		timer.Start();
 
-		// Start a number of worker threads that share the stack.
-		for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
-		{
-			// Start worker thread.
-			workers.push_back(std::thread(StackTestTaskCustom, std::ref(stack)));
-		}
-
-		// Join all worker threads.
+		// Submit a number of jobs that share the stack and wait for them.
 		for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
 		{
-			workers[i].join();
+			jobs.Submit(jobs.GetMainWorker(), buffered ? StackTestJobBuffered : StackTestJobCustom, &jobData[i]);
 		}
 
-		workers.clear();
+		jobs.WaitFrame();
 
 		// Clear the stack.
 		//std::cout << stack.allocator.GetAllocatedSize() << std::endl;
@@ -512,20 +1675,17 @@ double StackTestCustom()
 		double elapsed = timer.Stop();
 
 		// Store profiling data.
-		totalTime += elapsed;
-		frameCount++;
-
-		if (elapsed < minTime)
-			minTime = elapsed;
-		if (elapsed > maxTime)
-			maxTime = elapsed;
+		stats.Add(elapsed);
 	}
 
-	double avgFrameTime = totalTime / frameCount;
-	std::cout << "Average Frame Time: " << avgFrameTime << std::endl;
-	std::cout << "Min Frame Time: " << minTime << std::endl;
-	std::cout << "Max Frame Time: " << maxTime << std::endl;
-	return avgFrameTime;
+	stats.Print();
+
+	if (buffered)
+	{
+		for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
+			std::cout << "Job " << i << " Waste Per Frame: " << waste[i] / stats.frameCount << " bytes" << std::endl;
+	}
+	return stats.GetAverage();
 }
 
 double StackTestCustomUnthreaded()
@@ -533,10 +1693,7 @@ double StackTestCustomUnthreaded()
 	Timer timer;
 	StackMemoryManager stack(STACK_TEST_WORKER_COUNT * STACK_TEST_OBJECTS_PER_WORKER * STACK_MAX_ALLOC_SIZE);
 
-	double totalTime = 0.0;
-	double minTime = +100000000.0;
-	double maxTime = -100000000.0;
-	int frameCount = 0;
+	FrameStats stats;
 
 	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
 	{
@@ -556,74 +1713,199 @@ double StackTestCustomUnthreaded()
 		double elapsed = timer.Stop();
 
 		// Store profiling data.
-		totalTime += elapsed;
-		frameCount++;
+		stats.Add(elapsed);
+	}
 
-		if (elapsed < minTime)
-			minTime = elapsed;
-		if (elapsed > maxTime)
-			maxTime = elapsed;
+	stats.Print();
+	return stats.GetAverage();
+}
+
+/*
+	Same workload as StackTestCustomUnthreaded, but every task runs in its own StackScope
+	and allocates SIMD aligned blocks. Memory is released after each task instead of at the
+	end of the frame, so the peak usage is that of a single task.
+*/
+double StackTestScopedUnthreaded()
+{
+	Timer timer;
+	StackAllocator stack(STACK_TEST_WORKER_COUNT * STACK_TEST_OBJECTS_PER_WORKER * STACK_MAX_ALLOC_SIZE);
+
+	FrameStats stats;
+	StackAllocator::Marker peak = 0;
+
+	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
+	{
+		// Start timing.
+		timer.Start();
+
+		for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
+		{
+			StackScope<StackAllocator> scope(stack);
+
+			for (size_t j = 0; j < STACK_TEST_OBJECTS_PER_WORKER; ++j)
+			{
+				char* ptr = (char*)stack.Alloc(RNDStack[j], STACK_TEST_ALIGNMENT);
+				assert(((size_t)ptr & (STACK_TEST_ALIGNMENT - 1)) == 0);
+			}
+
+			if (stack.GetMarker() > peak)
+				peak = stack.GetMarker();
+		}
+
+		// Measure time.
+		double elapsed = timer.Stop();
+
+		// Store profiling data.
+		stats.Add(elapsed);
 	}
 
-	double avgFrameTime = totalTime / frameCount;
-	std::cout << "Average Frame Time: " << avgFrameTime << std::endl;
-	std::cout << "Min Frame Time: " << minTime << std::endl;
-	std::cout << "Max Frame Time: " << maxTime << std::endl;
-	return avgFrameTime;
+	stats.Print();
+	std::cout << "Peak Stack Usage: " << peak / 1024 << " KB" << std::endl;
+	return stats.GetAverage();
 }
 
+/*
+	Same workload as StackTestCustomUnthreaded on a VirtualArena that reserves far more
+	address space than the test needs. Reports how much of it was committed and resident.
+*/
+double StackTestArenaUnthreaded(bool decommit)
+{
+	Timer timer;
+	size_t residentBefore = ProcessStats::GetResidentMemory();
+	VirtualArena arena(ARENA_TEST_RESERVE_SIZE, 64 * 1024, decommit);
+
+	FrameStats stats;
+	size_t peakCommitted = 0;
+
+	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
+	{
+		// Start timing.
+		timer.Start();
+
+		for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
+		{
+			for (size_t j = 0; j < STACK_TEST_OBJECTS_PER_WORKER; ++j)
+			{
+				char* ptr = (char*)arena.Alloc(RNDStack[j]);
+				ptr[0] = 0;
+			}
+		}
+
+		if (arena.GetCommittedSize() > peakCommitted)
+			peakCommitted = arena.GetCommittedSize();
+
+		// Clear the stack.
+		arena.Clear();
+
+		// Measure time.
+		double elapsed = timer.Stop();
+
+		// Store profiling data.
+		stats.Add(elapsed);
+	}
+
+	stats.Print();
+	std::cout << "Reserved: " << arena.GetTotalSize() / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "Peak Committed: " << peakCommitted / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "Committed After Clear: " << arena.GetCommittedSize() / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "Resident: " << (ProcessStats::GetResidentMemory() - residentBefore) / (1024 * 1024) << " MB" << std::endl;
+	return stats.GetAverage();
+}
 
 double StackTestDefault()
 {
 	Timer timer;
-	std::vector<std::thread> workers;
-	workers.reserve(STACK_TEST_WORKER_COUNT);
+	JobSystem jobs(STACK_TEST_WORKER_COUNT - 1);
 
-	double totalTime = 0.0;
-	double minTime = +100000000.0;
-	double maxTime = -100000000.0;
-	int frameCount = 0;
+	FrameStats stats;
 
 	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
 	{
 		// Start timing.
 		timer.Start();
 
-		// Start a number of worker threads that allocate memory with default new.
+		// Submit a number of jobs that allocate memory with default new and wait for them.
 		for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
 		{
-			// Start worker thread.
-			workers.push_back(std::thread(StackTestTaskDefault));
+			jobs.Submit(jobs.GetMainWorker(), StackTestJobDefault, nullptr);
 		}
 
-		// Join all worker threads.
+		jobs.WaitFrame();
+
+		// Measure time.
+		double elapsed = timer.Stop();
+
+		// Store profiling data.
+		stats.Add(elapsed);
+	}
+
+	stats.Print();
+	return stats.GetAverage();
+}
+
+/*
+	Same jobs as StackTestCustom, but each allocates from the frame allocator of the worker
+	that runs it. Those are only touched by their own thread, so nothing is shared, and
+	the job system clears them at the frame barrier.
+*/
+double StackTestJobFrame()
+{
+	Timer timer;
+	JobSystem jobs(STACK_TEST_WORKER_COUNT - 1, STACK_TEST_WORKER_COUNT * STACK_TEST_OBJECTS_PER_WORKER * STACK_MAX_ALLOC_SIZE);
+
+	FrameStats stats;
+
+	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
+	{
+		// Start timing.
+		timer.Start();
+
 		for (size_t i = 0; i < STACK_TEST_WORKER_COUNT; ++i)
 		{
-			workers[i].join();
+			jobs.Submit(jobs.GetMainWorker(), StackTestJobFrameTask, &jobs);
 		}
 
-		workers.clear();
+		jobs.WaitFrame();
 
 		// Measure time.
 		double elapsed = timer.Stop();
 
 		// Store profiling data.
-		totalTime += elapsed;
-		frameCount++;
-
-		if (elapsed < minTime)
-			minTime = elapsed;
-		if (elapsed > maxTime)
-			maxTime = elapsed;
+		stats.Add(elapsed);
 	}
 
-	double avgFrameTime = totalTime / frameCount;
-	std::cout << "Average Frame Time: " << avgFrameTime << std::endl;
-	std::cout << "Min Frame Time: " << minTime << std::endl;
-	std::cout << "Max Frame Time: " << maxTime << std::endl;
-	return avgFrameTime;
+	stats.Print();
+	std::cout << "Steals Per Frame: " << (double)jobs.GetStealCount() / stats.frameCount << std::endl;
+	return stats.GetAverage();
+}
+
+void StackTestJobCustom(void* data, unsigned int)
+{
+	StackTestTaskCustom(*((StackTestJob*)data)->stack);
+}
+
+void StackTestJobBuffered(void* data, unsigned int)
+{
+	StackTestJob* job = (StackTestJob*)data;
+	StackTestTaskBuffered(*job->stack, job->bufferSize, *job->waste);
+}
+
+void StackTestJobDefault(void*, unsigned int)
+{
+	StackTestTaskDefault();
 }
 
+void StackTestJobFrameTask(void* data, unsigned int worker)
+{
+	PROFILE_ZONE("Stack Job");
+	VirtualArena& frame = ((JobSystem*)data)->GetFrameAllocator(worker);
+
+	for (size_t i = 0; i < STACK_TEST_OBJECTS_PER_WORKER; ++i)
+	{
+		char* ptr = (char*)frame.Alloc(RNDStack[i]);
+		ptr[0] = (char)i;
+	}
+}
 
 void StackTestTaskCustom(StackMemoryManager& stack)
 {
@@ -636,6 +1918,19 @@ void StackTestTaskCustom(StackMemoryManager& stack)
 }
 
 
+void StackTestTaskBuffered(StackMemoryManager& stack, size_t bufferSize, size_t& waste)
+{
+	StackThreadBuffer buffer(stack, bufferSize);
+
+	for (size_t i = 0; i < STACK_TEST_OBJECTS_PER_WORKER; ++i)
+	{
+		char* ptr = (char*)buffer.Alloc(RNDStack[i]);
+	}
+
+	waste += buffer.GetWaste();
+}
+
+
 void StackTestTaskDefault()
 {
 	std::vector<void*> stack(STACK_TEST_OBJECTS_PER_WORKER);
@@ -658,10 +1953,7 @@ void StackTestTaskDefault()
 double StackTestDefaultUnthreaded()
 {
 	Timer timer;
-	double totalTime = 0.0;
-	double minTime = +100000000.0;
-	double maxTime = -100000000.0;
-	int frameCount = 0;
+	FrameStats stats;
 
 	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
 	{
@@ -678,19 +1970,211 @@ double StackTestDefaultUnthreaded()
 		double elapsed = timer.Stop();
 
 		// Store profiling data.
-		totalTime += elapsed;
-		frameCount++;
+		stats.Add(elapsed);
+	}
 
-		if (elapsed < minTime)
-			minTime = elapsed;
-		if (elapsed > maxTime)
-			maxTime = elapsed;
+	stats.Print();
+	return stats.GetAverage();
+
+}
+
+// Prints allocator specific statistics for the blocks still live at the end of a heap test.
+template <typename T>
+inline void HeapTestReport(T&, size_t) {}
+
+inline void HeapTestReport(BuddyAllocator& allocator, size_t liveBytes)
+{
+	std::cout << "Live Requested: " << liveBytes / 1024 << " KB, Live Blocks: " << allocator.GetUsedSize() / 1024 << " KB" << std::endl;
+	std::cout << "Free Blocks: " << allocator.GetFreeBlockCount() << ", Largest Free Block: " << allocator.GetLargestFreeBlock() / 1024 << " KB" << std::endl;
+	std::cout << "Fragmentation: " << allocator.GetFragmentation() * 100.0 << "%" << std::endl;
+}
+
+/*
+	Variable-size heap churn using the RNDStack size distribution.
+
+	Every frame half of the live blocks are freed and replaced with blocks of a new size,
+	so allocations and frees of mixed sizes are interleaved.
+*/
+template <typename T>
+double HeapTest(T& allocator, double& maxFrameTime)
+{
+	Timer timer;
+	std::vector<void*> blocks(STACK_TEST_OBJECTS_PER_WORKER, nullptr);
+	std::vector<size_t> sizes(STACK_TEST_OBJECTS_PER_WORKER, 0);
+
+	FrameStats stats;
+
+	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
+	{
+		// Start timing.
+		timer.Start();
+
+		for (size_t i = k & 1; i < STACK_TEST_OBJECTS_PER_WORKER; i += 2)
+		{
+			if (blocks[i] != nullptr)
+				allocator.Free(blocks[i]);
+
+			sizes[i] = RNDStack[(i + k) % STACK_TEST_OBJECTS_PER_WORKER];
+			blocks[i] = allocator.Alloc(sizes[i]);
+		}
+
+		// Measure time.
+		double elapsed = timer.Stop();
+
+		// Store profiling data.
+		stats.Add(elapsed);
+	}
+
+	stats.Print();
+
+	size_t liveBytes = 0;
+	for (size_t i = 0; i < STACK_TEST_OBJECTS_PER_WORKER; ++i)
+		liveBytes += sizes[i];
+	HeapTestReport(allocator, liveBytes);
+
+	for (size_t i = 0; i < STACK_TEST_OBJECTS_PER_WORKER; ++i)
+	{
+		if (blocks[i] != nullptr)
+			allocator.Free(blocks[i]);
+	}
+
+	maxFrameTime = stats.maxTime;
+	return stats.GetAverage();
+}
+
+/*
+	Fragments a RelocatableHeap by filling it with RNDStack sized blocks and freeing every
+	other one, then compacts it with at most frameBudget_bytes moved per frame.
+	Only the Defragment calls are timed.
+*/
+void HeapTestDefrag(size_t frameBudget_bytes)
+{
+	RelocatableHeap heap(HEAP_TEST_ARENA_SIZE, STACK_TEST_OBJECTS_PER_WORKER);
+	std::vector<RelocatableHeap::Handle> handles(STACK_TEST_OBJECTS_PER_WORKER, RelocatableHeap::INVALID_HANDLE);
+
+	for (size_t i = 0; i < STACK_TEST_OBJECTS_PER_WORKER; ++i)
+	{
+		handles[i] = heap.Alloc(RNDStack[i]);
+		((char*)heap.Get(handles[i]))[0] = (char)i;
+	}
+
+	for (size_t i = 0; i < STACK_TEST_OBJECTS_PER_WORKER; i += 2)
+	{
+		heap.Free(handles[i]);
+		handles[i] = RelocatableHeap::INVALID_HANDLE;
+	}
+
+	std::cout << "Fragmentation Before: " << heap.GetFragmentation() * 100.0 << "% (" << heap.GetFreeBlockCount() << " free blocks, largest " << heap.GetLargestFreeBlock() / 1024 << " KB)" << std::endl;
+
+	Timer timer;
+	FrameStats stats;
+	size_t totalMoved = 0;
+
+	while (!heap.IsCompacted())
+	{
+		timer.Start();
+		totalMoved += heap.Defragment(frameBudget_bytes);
+		double elapsed = timer.Stop();
+
+		stats.Add(elapsed);
+	}
+
+	for (size_t i = 1; i < STACK_TEST_OBJECTS_PER_WORKER; i += 2)
+	{
+		assert(((char*)heap.Get(handles[i]))[0] == (char)i && "Block contents lost while moving");
+		heap.Free(handles[i]);
+	}
+
+	std::cout << "Fragmentation After: " << heap.GetFragmentation() * 100.0 << "%" << std::endl;
+	std::cout << "Frames Needed: " << stats.frameCount << std::endl;
+	std::cout << "Moved: " << totalMoved / 1024 << " KB" << std::endl;
+	std::cout << "Average Defrag Time: " << stats.GetAverage() << std::endl;
+	std::cout << "Min Defrag Time: " << stats.minTime << std::endl;
+	std::cout << "Max Defrag Time: " << stats.maxTime << std::endl;
+}
+
+inline void FrameTestFree(RingFrameAllocator&, void*) {}
+inline void FrameTestFree(DefaultFrameAllocator&, void* ptr) { delete [] (char*)ptr; }
+
+/*
+	Producer/consumer test for data that lives longer than a frame.
+
+	The main thread fills a frame with RNDStack sized blocks and hands it to a consumer
+	thread, which reads it during the following frame and then retires it.
+	Only the producer side is timed. Time spent waiting on the consumer, in BeginFrame
+	and for the block list, is reported apart from the frame time.
+*/
+template <typename T>
+double FrameTest(T& allocator)
+{
+	Timer timer;
+	FrameTestQueue queue;
+	queue.produced = -1;
+	queue.consumed = -1;
+
+	std::thread consumer(FrameTestConsumer<T>, std::ref(allocator), std::ref(queue));
+
+	FrameStats stats;
+	FrameStats waitStats;
+
+	for (size_t k = 0; k < STACK_TEST_FRAME_COUNT; ++k)
+	{
+		timer.Start();
+
+		allocator.BeginFrame();
+
+		// The block list of this slot must have been consumed.
+		while (queue.consumed.load() < (long long)k - (long long)FRAME_TEST_RING_SIZE)
+			std::this_thread::yield();
+
+		waitStats.Add(timer.Stop());
+
+		// Start timing.
+		timer.Start();
+
+		std::vector<void*>& blocks = queue.blocks[k % FRAME_TEST_RING_SIZE];
+		blocks.resize(STACK_TEST_OBJECTS_PER_WORKER);
+
+		for (size_t i = 0; i < STACK_TEST_OBJECTS_PER_WORKER; ++i)
+		{
+			char* ptr = (char*)allocator.Alloc(RNDStack[i]);
+			ptr[0] = (char)i;
+			blocks[i] = ptr;
+		}
+
+		queue.produced.store(k);
+
+		// Measure time.
+		double elapsed = timer.Stop();
+
+		// Store profiling data.
+		stats.Add(elapsed);
 	}
 
-	double avgFrameTime = totalTime / frameCount;
-	std::cout << "Average Frame Time: " << avgFrameTime << std::endl;
-	std::cout << "Min Frame Time: " << minTime << std::endl;
-	std::cout << "Max Frame Time: " << maxTime << std::endl;
-	return avgFrameTime;
+	consumer.join();
+
+	stats.Print();
+	std::cout << "Average Wait Time: " << waitStats.GetAverage() << std::endl;
+	std::cout << "Max Wait Time: " << waitStats.maxTime << std::endl;
+	return stats.GetAverage();
+}
+
+template <typename T>
+void FrameTestConsumer(T& allocator, FrameTestQueue& queue)
+{
+	for (long long k = 0; k < (long long)STACK_TEST_FRAME_COUNT; ++k)
+	{
+		while (queue.produced.load() < k)
+			std::this_thread::yield();
+
+		std::vector<void*>& blocks = queue.blocks[k % FRAME_TEST_RING_SIZE];
+		for (size_t i = 0; i < blocks.size(); ++i)
+		{
+			assert(((char*)blocks[i])[0] == (char)i && "Frame data overwritten before it was consumed");
+			FrameTestFree(allocator, blocks[i]);
+		}
 
+		allocator.Retire(k);
+		queue.consumed.store(k);
+	}
 }
@@ -0,0 +1,132 @@
+#include "BackingStore.h"
+#include <malloc.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static MallocBackingStore s_mallocStore;
+
+BackingStore& BackingStore::Default()
+{
+	return s_mallocStore;
+}
+
+void* MallocBackingStore::Allocate(size_t size)
+{
+	return malloc(size);
+}
+
+void MallocBackingStore::Release(void* ptr, size_t)
+{
+	free(ptr);
+}
+
+
+PageBackingStore::PageBackingStore(unsigned flags)
+	: m_flags(flags), m_fallbacks(0)
+{}
+
+size_t PageBackingStore::MappedSize(size_t size) const
+{
+	if (m_flags & (PAGE_BACKING_HUGE_PAGES | PAGE_BACKING_HUGETLB))
+		return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+	return size;
+}
+
+#ifdef _WIN32
+
+void* PageBackingStore::Allocate(size_t size)
+{
+	size_t mapped = MappedSize(size);
+	void* ptr = nullptr;
+
+	// Large pages need the "Lock pages in memory" privilege, without it normal pages are used.
+	if (m_flags & (PAGE_BACKING_HUGE_PAGES | PAGE_BACKING_HUGETLB))
+	{
+		size_t large = GetLargePageMinimum();
+		if (large != 0 && mapped % large == 0)
+			ptr = VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+		if (ptr == nullptr && (m_flags & PAGE_BACKING_HUGETLB))
+			m_fallbacks++;
+	}
+
+	if (ptr == nullptr)
+		ptr = VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+	if (ptr != nullptr && (m_flags & PAGE_BACKING_PREFAULT))
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		for (size_t offset = 0; offset < mapped; offset += info.dwPageSize)
+			((volatile char*)ptr)[offset] = 0;
+	}
+
+	return ptr;
+}
+
+void PageBackingStore::Release(void* ptr, size_t)
+{
+	VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#else
+
+void* PageBackingStore::Allocate(size_t size)
+{
+	size_t mapped = MappedSize(size);
+	int populate = (m_flags & PAGE_BACKING_PREFAULT) ? MAP_POPULATE : 0;
+
+	if (m_flags & PAGE_BACKING_HUGETLB)
+	{
+		void* ptr = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+		if (ptr != MAP_FAILED)
+			return ptr;
+
+		// No huge pages reserved in the system, use normal pages.
+		m_fallbacks++;
+	}
+
+	if (m_flags & PAGE_BACKING_HUGE_PAGES)
+	{
+		// Over-map so the block can start on a huge page boundary, then trim the excess.
+		char* raw = (char*)mmap(nullptr, mapped + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (raw == MAP_FAILED)
+			return nullptr;
+
+		char* ptr = (char*)(((size_t)raw + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+		if (ptr != raw)
+			munmap(raw, ptr - raw);
+		munmap(ptr + mapped, raw + HUGE_PAGE_SIZE - ptr);
+
+		madvise(ptr, mapped, MADV_HUGEPAGE);
+
+		// MAP_POPULATE would have faulted in before the advice, touch the pages instead.
+		if (populate)
+		{
+			for (size_t offset = 0; offset < mapped; offset += (size_t)sysconf(_SC_PAGESIZE))
+				((volatile char*)ptr)[offset] = 0;
+		}
+
+		return ptr;
+	}
+
+	void* ptr = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | populate, -1, 0);
+	return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+void PageBackingStore::Release(void* ptr, size_t size)
+{
+	munmap(ptr, MappedSize(size));
+}
+
+#endif
+
+unsigned PageBackingStore::GetFallbackCount() const
+{
+	return m_fallbacks;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+	Where an allocator gets its large blocks of memory from.
+	Allocators that take a BackingStore* fall back to BackingStore::Default() for nullptr.
+*/
+class BackingStore
+{
+public:
+	virtual ~BackingStore() {}
+
+	// Returns a block of at least size bytes, or nullptr.
+	virtual void* Allocate(size_t size) = 0;
+
+	// Gives back a block from Allocate, size must match the requested size.
+	virtual void Release(void* ptr, size_t size) = 0;
+
+	// The malloc backed store.
+	static BackingStore& Default();
+};
+
+class MallocBackingStore : public BackingStore
+{
+public:
+	void* Allocate(size_t size);
+	void Release(void* ptr, size_t size);
+};
+
+enum PageBackingFlags
+{
+	PAGE_BACKING_PREFAULT	= 1 << 0,	// Fault every page in when the block is mapped (MAP_POPULATE).
+	PAGE_BACKING_HUGE_PAGES	= 1 << 1,	// Ask for transparent huge pages (MADV_HUGEPAGE).
+	PAGE_BACKING_HUGETLB	= 1 << 2	// Map explicit huge pages (MAP_HUGETLB, MEM_LARGE_PAGES), falls back to normal pages.
+};
+
+/*
+	Maps every block straight from the OS instead of going through malloc.
+	Blocks asking for huge pages are rounded up to and aligned on the huge page size.
+*/
+class PageBackingStore : public BackingStore
+{
+public:
+	static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	// flags is a combination of PageBackingFlags.
+	PageBackingStore(unsigned flags = 0);
+
+	void* Allocate(size_t size);
+	void Release(void* ptr, size_t size);
+
+	// Number of blocks that asked for explicit huge pages but got normal pages.
+	unsigned GetFallbackCount() const;
+
+private:
+	size_t MappedSize(size_t size) const;
+
+	unsigned m_flags;
+	unsigned m_fallbacks;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit. mask must not be zero.
+inline unsigned CountTrailingZeros(unsigned mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+inline unsigned CountTrailingZeros64(unsigned long long mask)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned low = (unsigned)mask;
+	return low != 0 ? CountTrailingZeros(low) : 32 + CountTrailingZeros((unsigned)(mask >> 32));
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+// Index of the highest set bit. mask must not be zero.
+inline unsigned HighestSetBit64(unsigned long long mask)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+	unsigned long index;
+	_BitScanReverse64(&index, mask);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	unsigned high = (unsigned)(mask >> 32);
+	if (high != 0)
+	{
+		_BitScanReverse(&index, high);
+		return 32 + index;
+	}
+	_BitScanReverse(&index, (unsigned)mask);
+	return index;
+#else
+	return 63 - __builtin_clzll(mask);
+#endif
+}
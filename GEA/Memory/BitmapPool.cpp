@@ -0,0 +1,106 @@
+#include "BitmapPool.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+BitmapPool::BitmapPool(unsigned elementSize, unsigned numElements)
+	: m_mem(nullptr), m_words(nullptr), m_wordCount(0), m_firstFree(0), m_elementSize(elementSize), m_numElements(numElements), m_count(0)
+{
+	assert(numElements > 0 && "Pool needs at least one element");
+
+	m_mem = (char*)malloc((size_t)elementSize * numElements);
+
+	m_wordCount = (numElements + WORD_BITS - 1) / WORD_BITS;
+	m_words = new unsigned long long[m_wordCount];
+	memset(m_words, 0, m_wordCount * sizeof(unsigned long long));
+
+	// Mark the slots past the end of the last word as taken so Alloc never hands them out.
+	unsigned tail = numElements % WORD_BITS;
+	if (tail != 0)
+		m_words[m_wordCount - 1] = ~0ull << tail;
+}
+
+BitmapPool::~BitmapPool()
+{
+	delete [] m_words;
+	free(m_mem);
+}
+
+void* BitmapPool::Alloc()
+{
+	while (m_firstFree < m_wordCount && m_words[m_firstFree] == ~0ull)
+		m_firstFree++;
+
+	if (m_firstFree == m_wordCount)
+		return nullptr;
+
+	unsigned long long& word = m_words[m_firstFree];
+	unsigned bit = CountTrailingZeros64(~word);
+	word |= 1ull << bit;
+	m_count++;
+
+	return m_mem + ((size_t)m_firstFree * WORD_BITS + bit) * m_elementSize;
+}
+
+void BitmapPool::Free(void* ptr)
+{
+	unsigned index = GetIndex(ptr);
+	unsigned w = index / WORD_BITS;
+	unsigned long long bit = 1ull << (index % WORD_BITS);
+
+	assert((m_words[w] & bit) != 0 && "Element freed twice");
+
+	m_words[w] &= ~bit;
+	m_count--;
+
+	if (w < m_firstFree)
+		m_firstFree = w;
+}
+
+unsigned BitmapPool::AllocN(void** out, unsigned count)
+{
+	unsigned n = 0;
+	while (n < count)
+	{
+		void* ptr = Alloc();
+		if (ptr == nullptr)
+			break;
+		out[n++] = ptr;
+	}
+	return n;
+}
+
+void BitmapPool::FreeN(void** ptrs, unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i)
+		Free(ptrs[i]);
+}
+
+bool BitmapPool::IsLive(unsigned index) const
+{
+	assert(index < m_numElements && "Index out of range");
+	return (m_words[index / WORD_BITS] & (1ull << (index % WORD_BITS))) != 0;
+}
+
+void* BitmapPool::GetElement(unsigned index) const
+{
+	assert(index < m_numElements && "Index out of range");
+	return m_mem + (size_t)index * m_elementSize;
+}
+
+unsigned BitmapPool::GetIndex(const void* ptr) const
+{
+	size_t offset = (const char*)ptr - m_mem;
+	assert(offset < (size_t)m_elementSize * m_numElements && offset % m_elementSize == 0 && "Pointer does not belong to this pool");
+	return (unsigned)(offset / m_elementSize);
+}
+
+unsigned BitmapPool::GetCount() const
+{
+	return m_count;
+}
+
+unsigned BitmapPool::GetCapacity() const
+{
+	return m_numElements;
+}
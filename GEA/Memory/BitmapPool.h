@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include "BitScan.h"
+
+/*
+	Fixed-size pool that tracks occupancy in a bitmap instead of a free list.
+
+	Alloc takes the lowest free slot, found with one bit scan per 64 slots, so live
+	elements stay packed towards the start of the block. ForEach walks the set bits,
+	which visits only live elements and in address order, without a side array.
+*/
+class BitmapPool
+{
+public:
+	BitmapPool(unsigned elementSize, unsigned numElements);
+	~BitmapPool();
+
+	// Returns nullptr when the pool is full.
+	void* Alloc();
+	void Free(void* ptr);
+
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
+
+	// Calls func(void*) for every live element in address order. func may Free the
+	// element it is given, but must not allocate.
+	template <typename F>
+	void ForEach(F func);
+
+	bool IsLive(unsigned index) const;
+	void* GetElement(unsigned index) const;
+	unsigned GetIndex(const void* ptr) const;
+	unsigned GetCount() const;
+	unsigned GetCapacity() const;
+
+private:
+	static const unsigned WORD_BITS = 64;
+
+	char* m_mem;
+	unsigned long long* m_words;
+	unsigned m_wordCount;
+	// No word below this one has a clear bit.
+	unsigned m_firstFree;
+
+	unsigned m_elementSize;
+	unsigned m_numElements;
+	unsigned m_count;
+};
+
+template <typename F>
+void BitmapPool::ForEach(F func)
+{
+	for (unsigned w = 0; w < m_wordCount; ++w)
+	{
+		// Work on a copy, so freeing the current element does not disturb the walk.
+		unsigned long long word = m_words[w];
+		while (word != 0)
+		{
+			unsigned index = w * WORD_BITS + CountTrailingZeros64(word);
+			word &= word - 1;
+
+			// The padding bits at the end of the last word are always set.
+			if (index >= m_numElements)
+				return;
+
+			func(m_mem + (size_t)index * m_elementSize);
+		}
+	}
+}
@@ -0,0 +1,206 @@
+#include "BuddyAllocator.h"
+#include "BitScan.h"
+#include "VirtualMemory.h"
+#include <cassert>
+#include <cstring>
+
+static unsigned CeilLog2(size_t size)
+{
+	return size <= 1 ? 0 : HighestSetBit64(size - 1) + 1;
+}
+
+BuddyAllocator::BuddyAllocator(size_t arenaSize_bytes, size_t minBlockSize_bytes, bool prefault)
+	: m_reserved(nullptr), m_arena(nullptr), m_reservedSize(0), m_arenaSize(0), m_arenaLog2(0), m_minLog2(0), m_levelCount(0), m_levelMask(0), m_freeBits(nullptr), m_blockLevels(nullptr), m_usedSize(0)
+{
+	m_arenaLog2 = CeilLog2(arenaSize_bytes);
+	m_minLog2 = CeilLog2(minBlockSize_bytes < sizeof(FreeBlock) ? sizeof(FreeBlock) : minBlockSize_bytes);
+	assert(m_minLog2 <= m_arenaLog2 && "Minimum block larger than the arena");
+
+	m_arenaSize = (size_t)1 << m_arenaLog2;
+	m_levelCount = m_arenaLog2 - m_minLog2 + 1;
+	assert(m_levelCount <= MAX_LEVELS && "Too many levels");
+
+	// Reserve twice the arena so a range aligned to the arena size fits, and commit only that.
+	m_reservedSize = m_arenaSize * 2;
+	m_reserved = (char*)VirtualMemory::Reserve(m_reservedSize);
+	assert(m_reserved != nullptr && "Failed to reserve address space");
+
+	m_arena = (char*)(((size_t)m_reserved + m_arenaSize - 1) & ~(m_arenaSize - 1));
+	bool committed = VirtualMemory::Commit(m_arena, m_arenaSize);
+	assert(committed && "Failed to commit the arena");
+	(void)committed;
+
+	if (prefault)
+		VirtualMemory::Prefault(m_arena, m_arenaSize);
+
+	size_t nodeCount = ((size_t)1 << m_levelCount) - 1;
+	m_freeBits = new unsigned char[(nodeCount + 7) / 8];
+	memset(m_freeBits, 0, (nodeCount + 7) / 8);
+
+	size_t minBlockCount = m_arenaSize >> m_minLog2;
+	m_blockLevels = new unsigned char[minBlockCount];
+	memset(m_blockLevels, NO_LEVEL, minBlockCount);
+
+	for (unsigned i = 0; i < MAX_LEVELS; ++i)
+	{
+		m_freeLists[i] = nullptr;
+		m_freeCounts[i] = 0;
+	}
+
+	Push(0, m_arena);
+}
+
+BuddyAllocator::~BuddyAllocator()
+{
+	delete [] m_blockLevels;
+	delete [] m_freeBits;
+	VirtualMemory::Release(m_reserved, m_reservedSize);
+}
+
+unsigned BuddyAllocator::LevelFor(size_t size_bytes) const
+{
+	unsigned log2 = CeilLog2(size_bytes);
+	if (log2 < m_minLog2)
+		log2 = m_minLog2;
+	return m_arenaLog2 - log2;
+}
+
+size_t BuddyAllocator::LevelSize(unsigned level) const
+{
+	return m_arenaSize >> level;
+}
+
+size_t BuddyAllocator::NodeIndex(size_t offset, unsigned level) const
+{
+	return ((size_t)1 << level) - 1 + (offset >> (m_arenaLog2 - level));
+}
+
+void BuddyAllocator::Push(unsigned level, char* block)
+{
+	FreeBlock* node = (FreeBlock*)block;
+	node->m_prev = nullptr;
+	node->m_next = m_freeLists[level];
+	if (node->m_next != nullptr)
+		node->m_next->m_prev = node;
+	m_freeLists[level] = node;
+
+	m_freeCounts[level]++;
+	m_levelMask |= 1ull << level;
+
+	size_t nodeIndex = NodeIndex(block - m_arena, level);
+	m_freeBits[nodeIndex / 8] |= (unsigned char)(1 << (nodeIndex % 8));
+}
+
+void BuddyAllocator::Unlink(unsigned level, char* block)
+{
+	FreeBlock* node = (FreeBlock*)block;
+	if (node->m_prev != nullptr)
+		node->m_prev->m_next = node->m_next;
+	else
+		m_freeLists[level] = node->m_next;
+	if (node->m_next != nullptr)
+		node->m_next->m_prev = node->m_prev;
+
+	if (--m_freeCounts[level] == 0)
+		m_levelMask &= ~(1ull << level);
+
+	size_t nodeIndex = NodeIndex(block - m_arena, level);
+	m_freeBits[nodeIndex / 8] &= (unsigned char)~(1 << (nodeIndex % 8));
+}
+
+void* BuddyAllocator::Alloc(size_t size_bytes)
+{
+	if (size_bytes > m_arenaSize)
+		return nullptr;
+
+	unsigned level = LevelFor(size_bytes);
+
+	// The deepest level at or above the target that has a free block, i.e. the smallest block that fits.
+	unsigned long long candidates = m_levelMask & ((2ull << level) - 1);
+	if (candidates == 0)
+		return nullptr;
+
+	unsigned from = HighestSetBit64(candidates);
+	char* block = (char*)m_freeLists[from];
+	Unlink(from, block);
+
+	// Split down, handing the upper halves to the free lists on the way.
+	while (from < level)
+	{
+		from++;
+		Push(from, block + LevelSize(from));
+	}
+
+	m_blockLevels[(block - m_arena) >> m_minLog2] = (unsigned char)level;
+	m_usedSize += LevelSize(level);
+	return block;
+}
+
+void BuddyAllocator::Free(void* ptr)
+{
+	if (ptr == nullptr)
+		return;
+
+	size_t offset = (char*)ptr - m_arena;
+	assert(offset < m_arenaSize && "Pointer does not belong to this allocator");
+
+	unsigned char& blockLevel = m_blockLevels[offset >> m_minLog2];
+	assert(blockLevel != NO_LEVEL && "Block freed twice or not allocated here");
+
+	unsigned level = blockLevel;
+	blockLevel = NO_LEVEL;
+	m_usedSize -= LevelSize(level);
+
+	// Merge with the buddy as long as it is free as a whole.
+	while (level > 0)
+	{
+		size_t buddy = offset ^ LevelSize(level);
+		size_t nodeIndex = NodeIndex(buddy, level);
+		if (!(m_freeBits[nodeIndex / 8] & (1 << (nodeIndex % 8))))
+			break;
+
+		Unlink(level, m_arena + buddy);
+		offset &= ~LevelSize(level);
+		level--;
+	}
+
+	Push(level, m_arena + offset);
+}
+
+size_t BuddyAllocator::GetArenaSize() const
+{
+	return m_arenaSize;
+}
+
+size_t BuddyAllocator::GetUsedSize() const
+{
+	return m_usedSize;
+}
+
+size_t BuddyAllocator::GetFreeSize() const
+{
+	return m_arenaSize - m_usedSize;
+}
+
+size_t BuddyAllocator::GetLargestFreeBlock() const
+{
+	if (m_levelMask == 0)
+		return 0;
+	return LevelSize(CountTrailingZeros64(m_levelMask));
+}
+
+unsigned BuddyAllocator::GetFreeBlockCount() const
+{
+	unsigned count = 0;
+	for (unsigned i = 0; i < m_levelCount; ++i)
+		count += m_freeCounts[i];
+	return count;
+}
+
+double BuddyAllocator::GetFragmentation() const
+{
+	size_t freeSize = GetFreeSize();
+	if (freeSize == 0)
+		return 0.0;
+	return 1.0 - (double)GetLargestFreeBlock() / (double)freeSize;
+}
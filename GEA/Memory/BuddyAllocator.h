@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+	Power-of-two block allocator over a single arena.
+
+	The arena is split in halves, quarters and so on down to the minimum block size.
+	Each level keeps a free list of its blocks, and Alloc splits a larger free block
+	until it reaches the level that fits the request. Free merges a block with its
+	buddy, the other half of the same parent, for as long as the buddy is free too.
+
+	Every block is aligned to its own size. The arena is committed from the OS up front, and
+	optionally prefaulted so first-touch page faults don't land in Alloc callers.
+*/
+class BuddyAllocator
+{
+public:
+	// Both sizes are rounded up to powers of two.
+	BuddyAllocator(size_t arenaSize_bytes, size_t minBlockSize_bytes = 64, bool prefault = false);
+	~BuddyAllocator();
+
+	// Returns nullptr when no block is large enough.
+	void* Alloc(size_t size_bytes);
+	void Free(void* ptr);
+
+	size_t GetArenaSize() const;
+	size_t GetUsedSize() const;
+	size_t GetFreeSize() const;
+	size_t GetLargestFreeBlock() const;
+	unsigned GetFreeBlockCount() const;
+	// Share of free memory that is not in the largest free block, 0 when it is all in one piece.
+	double GetFragmentation() const;
+
+private:
+	static const unsigned MAX_LEVELS = 48;
+	static const unsigned char NO_LEVEL = 0xFF;
+
+	struct FreeBlock
+	{
+		FreeBlock* m_next;
+		FreeBlock* m_prev;
+	};
+
+	// Level 0 is the whole arena, each following level halves the block size.
+	unsigned LevelFor(size_t size_bytes) const;
+	size_t LevelSize(unsigned level) const;
+	// Index of a block in the implicit tree over all levels, used for the free bits.
+	size_t NodeIndex(size_t offset, unsigned level) const;
+
+	void Push(unsigned level, char* block);
+	void Unlink(unsigned level, char* block);
+
+	char* m_reserved;
+	char* m_arena;
+	size_t m_reservedSize;
+	size_t m_arenaSize;
+	unsigned m_arenaLog2;
+	unsigned m_minLog2;
+	unsigned m_levelCount;
+
+	FreeBlock* m_freeLists[MAX_LEVELS];
+	unsigned m_freeCounts[MAX_LEVELS];
+	// Bit l set when level l has a free block.
+	unsigned long long m_levelMask;
+
+	// One bit per tree node, set while that block is on a free list.
+	unsigned char* m_freeBits;
+	// Level of the allocated block starting at each minimum block, NO_LEVEL otherwise.
+	unsigned char* m_blockLevels;
+
+	size_t m_usedSize;
+};
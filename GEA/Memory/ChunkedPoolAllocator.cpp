@@ -0,0 +1,262 @@
+#include "ChunkedPoolAllocator.h"
+#include "VirtualMemory.h"
+#include <cassert>
+
+ChunkedPoolAllocator::ChunkedPoolAllocator(unsigned elementSize, unsigned maxElements, size_t chunkSize_bytes,
+	ChunkRelease release, unsigned retainChunks, unsigned releaseDelayFrames)
+	: m_mem(nullptr), m_reserveSize(0), m_chunkSize(0), m_elementSize(0), m_chunkElements(0), m_chunkCount(0),
+	m_chunks(nullptr), m_unused(0), m_committedChunks(0),
+	m_release(release), m_retainChunks(retainChunks), m_releaseDelay(releaseDelayFrames), m_frame(0), m_releases(0), m_recommits(0)
+{
+	assert(elementSize >= sizeof(PoolElement) && "Element too small to hold a free list link");
+
+	// Round up to pointer alignment so the free list links in each element are aligned.
+	m_elementSize = (elementSize + sizeof(PoolElement) - 1) & ~(unsigned)(sizeof(PoolElement) - 1);
+
+	// Chunks are whole pages, so they can be committed and released on their own.
+	size_t page = VirtualMemory::GetPageSize();
+	m_chunkSize = (chunkSize_bytes + page - 1) / page * page;
+	if (m_chunkSize < m_elementSize)
+		m_chunkSize = (m_elementSize + page - 1) / page * page;
+
+	m_chunkElements = (unsigned)(m_chunkSize / m_elementSize);
+	m_chunkCount = (maxElements + m_chunkElements - 1) / m_chunkElements;
+	m_reserveSize = m_chunkSize * m_chunkCount;
+
+	m_mem = (char*)VirtualMemory::Reserve(m_reserveSize);
+	assert(m_mem != nullptr && "Failed to reserve address space");
+
+	m_chunks = new Chunk[m_chunkCount];
+	for (unsigned i = 0; i < m_chunkCount; ++i)
+	{
+		m_chunks[i].m_free = nullptr;
+		m_chunks[i].m_carved = 0;
+		m_chunks[i].m_live = 0;
+		m_chunks[i].m_state = CHUNK_UNUSED;
+		m_chunks[i].m_emptySince = 0;
+		m_chunks[i].m_prev = NULL_CHUNK;
+		m_chunks[i].m_next = NULL_CHUNK;
+	}
+
+	ChunkList empty = { NULL_CHUNK, NULL_CHUNK, 0 };
+	m_partial = empty;
+	m_empty = empty;
+	m_released = empty;
+}
+
+ChunkedPoolAllocator::~ChunkedPoolAllocator()
+{
+	delete [] m_chunks;
+	VirtualMemory::Release(m_mem, m_reserveSize);
+}
+
+void ChunkedPoolAllocator::PushFront(ChunkList& list, unsigned index)
+{
+	Chunk& chunk = m_chunks[index];
+	chunk.m_prev = NULL_CHUNK;
+	chunk.m_next = list.m_head;
+
+	if (list.m_head != NULL_CHUNK)
+		m_chunks[list.m_head].m_prev = index;
+	else
+		list.m_tail = index;
+
+	list.m_head = index;
+	list.m_count++;
+}
+
+void ChunkedPoolAllocator::Unlink(ChunkList& list, unsigned index)
+{
+	Chunk& chunk = m_chunks[index];
+
+	if (chunk.m_prev != NULL_CHUNK)
+		m_chunks[chunk.m_prev].m_next = chunk.m_next;
+	else
+		list.m_head = chunk.m_next;
+
+	if (chunk.m_next != NULL_CHUNK)
+		m_chunks[chunk.m_next].m_prev = chunk.m_prev;
+	else
+		list.m_tail = chunk.m_prev;
+
+	list.m_count--;
+}
+
+bool ChunkedPoolAllocator::AcquireChunk()
+{
+	unsigned index;
+
+	if (m_empty.m_head != NULL_CHUNK)
+	{
+		// Still has its pages.
+		index = m_empty.m_head;
+		Unlink(m_empty, index);
+	}
+	else if (m_released.m_head != NULL_CHUNK)
+	{
+		index = m_released.m_head;
+		Unlink(m_released, index);
+
+		if (m_release == CHUNK_RELEASE_DECOMMIT)
+		{
+			if (!VirtualMemory::Commit(m_mem + index * m_chunkSize, m_chunkSize))
+			{
+				PushFront(m_released, index);
+				return false;
+			}
+			m_committedChunks++;
+		}
+		m_recommits++;
+	}
+	else if (m_unused < m_chunkCount)
+	{
+		index = m_unused;
+		if (!VirtualMemory::Commit(m_mem + index * m_chunkSize, m_chunkSize))
+			return false;
+
+		m_unused++;
+		m_committedChunks++;
+	}
+	else
+	{
+		return false;
+	}
+
+	m_chunks[index].m_state = CHUNK_PARTIAL;
+	PushFront(m_partial, index);
+	return true;
+}
+
+void* ChunkedPoolAllocator::Alloc()
+{
+	if (m_partial.m_head == NULL_CHUNK && !AcquireChunk())
+		return nullptr;
+
+	unsigned index = m_partial.m_head;
+	Chunk& chunk = m_chunks[index];
+
+	void* ptr;
+	if (chunk.m_free != nullptr)
+	{
+		ptr = chunk.m_free;
+		chunk.m_free = chunk.m_free->m_next;
+	}
+	else
+	{
+		// Carve lazily so a fresh chunk only faults in the pages it hands out.
+		ptr = m_mem + index * m_chunkSize + (size_t)chunk.m_carved * m_elementSize;
+		chunk.m_carved++;
+	}
+
+	if (++chunk.m_live == m_chunkElements)
+	{
+		Unlink(m_partial, index);
+		chunk.m_state = CHUNK_FULL;
+	}
+
+	return ptr;
+}
+
+void ChunkedPoolAllocator::Free(void* ptr)
+{
+	size_t offset = (char*)ptr - m_mem;
+	assert(offset < m_reserveSize && "Pointer does not belong to this pool");
+
+	unsigned index = (unsigned)(offset / m_chunkSize);
+	Chunk& chunk = m_chunks[index];
+
+	PoolElement* element = (PoolElement*)ptr;
+	element->m_next = chunk.m_free;
+	chunk.m_free = element;
+
+	if (chunk.m_state == CHUNK_FULL)
+	{
+		chunk.m_state = CHUNK_PARTIAL;
+		PushFront(m_partial, index);
+	}
+
+	if (--chunk.m_live == 0)
+	{
+		Unlink(m_partial, index);
+
+		// Start over with a fresh carve, the free list would point into pages we may release.
+		chunk.m_free = nullptr;
+		chunk.m_carved = 0;
+		chunk.m_state = CHUNK_EMPTY;
+		chunk.m_emptySince = m_frame;
+		PushFront(m_empty, index);
+	}
+}
+
+unsigned ChunkedPoolAllocator::AllocN(void** out, unsigned count)
+{
+	unsigned n = 0;
+	while (n < count)
+	{
+		void* ptr = Alloc();
+		if (ptr == nullptr)
+			break;
+		out[n++] = ptr;
+	}
+	return n;
+}
+
+void ChunkedPoolAllocator::FreeN(void** ptrs, unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i)
+		Free(ptrs[i]);
+}
+
+void ChunkedPoolAllocator::Tick()
+{
+	m_frame++;
+
+	if (m_release == CHUNK_RELEASE_NONE)
+		return;
+
+	// Oldest empty chunks sit at the tail.
+	while (m_empty.m_count > m_retainChunks)
+	{
+		unsigned index = m_empty.m_tail;
+		Chunk& chunk = m_chunks[index];
+		if (chunk.m_emptySince + m_releaseDelay > m_frame)
+			break;
+
+		Unlink(m_empty, index);
+
+		char* mem = m_mem + index * m_chunkSize;
+		if (m_release == CHUNK_RELEASE_DECOMMIT)
+		{
+			VirtualMemory::Decommit(mem, m_chunkSize);
+			m_committedChunks--;
+		}
+		else
+		{
+			VirtualMemory::Reset(mem, m_chunkSize);
+		}
+
+		chunk.m_state = CHUNK_RELEASED;
+		PushFront(m_released, index);
+		m_releases++;
+	}
+}
+
+size_t ChunkedPoolAllocator::GetCommittedSize() const
+{
+	return m_committedChunks * m_chunkSize;
+}
+
+unsigned ChunkedPoolAllocator::GetEmptyChunkCount() const
+{
+	return m_empty.m_count;
+}
+
+unsigned long long ChunkedPoolAllocator::GetReleaseCount() const
+{
+	return m_releases;
+}
+
+unsigned long long ChunkedPoolAllocator::GetRecommitCount() const
+{
+	return m_recommits;
+}
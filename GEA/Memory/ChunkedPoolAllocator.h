@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include "PoolAllocator.h"
+
+enum ChunkRelease
+{
+	// Empty chunks keep their pages.
+	CHUNK_RELEASE_NONE,
+	// Empty chunks are decommitted, the pages go back to the OS straight away.
+	CHUNK_RELEASE_DECOMMIT,
+	// Empty chunks are reset, the OS takes the pages back only when it needs them.
+	CHUNK_RELEASE_LAZY,
+};
+
+/*
+	Pool split into fixed-size chunks that hands the pages of idle chunks back to the OS.
+
+	Each chunk has its own free list and live count, so the pool knows when a chunk has
+	become empty. Empty chunks are released by Tick, once per frame, after they have
+	stayed empty for releaseDelayFrames, and retainChunks of them are always kept.
+	That hysteresis stops a pool that hovers around a chunk boundary from releasing and
+	re-faulting the same pages every frame. Alloc prefers partly used chunks, then kept
+	empty ones, and only then commits a released one.
+
+	The address range for maxElements is reserved up front and chunks are committed
+	into it as needed, so a pointer maps to its chunk by a division.
+*/
+class ChunkedPoolAllocator
+{
+public:
+	ChunkedPoolAllocator(unsigned elementSize, unsigned maxElements, size_t chunkSize_bytes = 64 * 1024,
+		ChunkRelease release = CHUNK_RELEASE_DECOMMIT, unsigned retainChunks = 1, unsigned releaseDelayFrames = 60);
+	~ChunkedPoolAllocator();
+
+	// Returns nullptr when every chunk is full.
+	void* Alloc();
+	void Free(void* ptr);
+
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
+
+	// Advances the frame count and releases chunks that have been empty long enough.
+	void Tick();
+
+	size_t GetCommittedSize() const;
+	unsigned GetEmptyChunkCount() const;
+	unsigned long long GetReleaseCount() const;
+	unsigned long long GetRecommitCount() const;
+
+private:
+	ChunkedPoolAllocator(const ChunkedPoolAllocator&);
+	ChunkedPoolAllocator& operator=(const ChunkedPoolAllocator&);
+
+	static const unsigned NULL_CHUNK = 0xFFFFFFFF;
+
+	enum ChunkState
+	{
+		CHUNK_UNUSED,
+		CHUNK_PARTIAL,
+		CHUNK_FULL,
+		CHUNK_EMPTY,
+		CHUNK_RELEASED,
+	};
+
+	// Kept outside the chunk, so releasing its pages loses nothing.
+	struct Chunk
+	{
+		PoolElement* m_free;
+		// Elements carved off the chunk so far, the rest has never been touched.
+		unsigned m_carved;
+		unsigned m_live;
+		ChunkState m_state;
+		unsigned long long m_emptySince;
+		unsigned m_prev;
+		unsigned m_next;
+	};
+
+	struct ChunkList
+	{
+		unsigned m_head;
+		unsigned m_tail;
+		unsigned m_count;
+	};
+
+	void PushFront(ChunkList& list, unsigned index);
+	void Unlink(ChunkList& list, unsigned index);
+
+	// Finds a chunk with room and puts it on the partial list. Returns false if there is none.
+	bool AcquireChunk();
+
+	char* m_mem;
+	size_t m_reserveSize;
+	size_t m_chunkSize;
+	unsigned m_elementSize;
+	unsigned m_chunkElements;
+	unsigned m_chunkCount;
+
+	Chunk* m_chunks;
+	ChunkList m_partial;
+	// Most recently emptied first.
+	ChunkList m_empty;
+	ChunkList m_released;
+	// Chunks from here on have never been committed.
+	unsigned m_unused;
+	unsigned m_committedChunks;
+
+	ChunkRelease m_release;
+	unsigned m_retainChunks;
+	unsigned m_releaseDelay;
+	unsigned long long m_frame;
+
+	unsigned long long m_releases;
+	unsigned long long m_recommits;
+};
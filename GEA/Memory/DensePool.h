@@ -0,0 +1,153 @@
+#pragma once
+
+#include <malloc.h>
+#include <cstring>
+#include <cassert>
+
+/*
+	Pool that keeps its live objects packed at the front of one array.
+
+	Objects are addressed from outside by stable ids. Removing an object moves the
+	last live object into its slot (swap-and-pop), and a sparse id-to-index map plus
+	the reverse index-to-id map keep the ids valid. Updates can then walk the live
+	objects linearly with GetData()/GetCount() without touching dead slots.
+
+	Objects are moved with memcpy, so T must be trivially relocatable.
+*/
+template <typename T>
+class DensePool
+{
+public:
+	typedef unsigned int Id;
+
+	DensePool(unsigned capacity);
+	~DensePool();
+
+	// Returns storage for a new object at the end of the live range, construct into it with placement new.
+	// Returns nullptr when the pool is full.
+	void* Alloc(Id& id);
+	void Free(Id id);
+
+	// Removes the object at a dense index. The last live object moves into index,
+	// so when removing while iterating, don't advance past index.
+	void FreeAt(unsigned index);
+
+	T* Get(Id id) const;
+	Id GetId(unsigned index) const;
+
+	// Live objects are GetData()[0] to GetData()[GetCount() - 1].
+	T* GetData() const;
+	unsigned GetCount() const;
+	unsigned GetCapacity() const;
+
+private:
+	DensePool(const DensePool&);
+	DensePool& operator=(const DensePool&);
+
+	T* m_dense;
+	unsigned* m_denseToId;
+	unsigned* m_idToDense;
+	unsigned* m_freeIds;
+
+	unsigned m_count;
+	unsigned m_freeCount;
+	unsigned m_capacity;
+};
+
+template <typename T>
+DensePool<T>::DensePool(unsigned capacity)
+	: m_dense(nullptr), m_denseToId(nullptr), m_idToDense(nullptr), m_freeIds(nullptr), m_count(0), m_freeCount(capacity), m_capacity(capacity)
+{
+	m_dense = (T*)malloc(sizeof(T) * capacity);
+	m_denseToId = (unsigned*)malloc(sizeof(unsigned) * capacity);
+	m_idToDense = (unsigned*)malloc(sizeof(unsigned) * capacity);
+	m_freeIds = (unsigned*)malloc(sizeof(unsigned) * capacity);
+
+	// Hand out low ids first.
+	for (unsigned i = 0; i < capacity; ++i)
+		m_freeIds[i] = capacity - 1 - i;
+}
+
+template <typename T>
+DensePool<T>::~DensePool()
+{
+	free(m_dense);
+	free(m_denseToId);
+	free(m_idToDense);
+	free(m_freeIds);
+}
+
+template <typename T>
+void* DensePool<T>::Alloc(Id& id)
+{
+	if (m_freeCount == 0)
+		return nullptr;
+
+	id = m_freeIds[--m_freeCount];
+
+	unsigned index = m_count++;
+	m_idToDense[id] = index;
+	m_denseToId[index] = id;
+
+	return &m_dense[index];
+}
+
+template <typename T>
+void DensePool<T>::Free(Id id)
+{
+	assert(id < m_capacity && "Id out of range");
+
+	FreeAt(m_idToDense[id]);
+}
+
+template <typename T>
+void DensePool<T>::FreeAt(unsigned index)
+{
+	assert(index < m_count && "Index is not live");
+
+	unsigned id = m_denseToId[index];
+	unsigned last = --m_count;
+
+	if (index != last)
+	{
+		memcpy(&m_dense[index], &m_dense[last], sizeof(T));
+
+		unsigned movedId = m_denseToId[last];
+		m_denseToId[index] = movedId;
+		m_idToDense[movedId] = index;
+	}
+
+	m_freeIds[m_freeCount++] = id;
+}
+
+template <typename T>
+T* DensePool<T>::Get(Id id) const
+{
+	assert(id < m_capacity && "Id out of range");
+
+	return &m_dense[m_idToDense[id]];
+}
+
+template <typename T>
+typename DensePool<T>::Id DensePool<T>::GetId(unsigned index) const
+{
+	return m_denseToId[index];
+}
+
+template <typename T>
+T* DensePool<T>::GetData() const
+{
+	return m_dense;
+}
+
+template <typename T>
+unsigned DensePool<T>::GetCount() const
+{
+	return m_count;
+}
+
+template <typename T>
+unsigned DensePool<T>::GetCapacity() const
+{
+	return m_capacity;
+}
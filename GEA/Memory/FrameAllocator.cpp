@@ -0,0 +1,73 @@
+#include "FrameAllocator.h"
+#include <thread>
+#include <cassert>
+
+RingFrameAllocator::RingFrameAllocator(size_t frameSize_bytes, unsigned int frameCount)
+	: m_frames(nullptr), m_frameCount(frameCount), m_frame(-1), m_retired(-1), m_callback(nullptr), m_userData(nullptr)
+{
+	assert(frameCount > 0 && "Ring needs at least one frame");
+
+	m_frames = new StackAllocator*[frameCount];
+	for (unsigned int i = 0; i < frameCount; ++i)
+		m_frames[i] = new StackAllocator(frameSize_bytes);
+}
+
+RingFrameAllocator::~RingFrameAllocator()
+{
+	for (unsigned int i = 0; i < m_frameCount; ++i)
+		delete m_frames[i];
+	delete [] m_frames;
+}
+
+void RingFrameAllocator::BeginFrame()
+{
+	m_frame++;
+
+	long long previous = m_frame - m_frameCount;
+	if (previous < 0)
+		return;
+
+	// Wait for the consumers of the frame that last used this region.
+	while (m_retired.load(std::memory_order_acquire) < previous)
+		std::this_thread::yield();
+
+	if (m_callback != nullptr)
+		m_callback(previous, m_userData);
+
+	m_frames[m_frame % m_frameCount]->Clear();
+}
+
+void* RingFrameAllocator::Alloc(size_t size_bytes, size_t align)
+{
+	assert(m_frame >= 0 && "BeginFrame has not been called");
+
+	return m_frames[m_frame % m_frameCount]->Alloc(size_bytes, align);
+}
+
+void RingFrameAllocator::Retire(long long frame)
+{
+	long long retired = m_retired.load(std::memory_order_relaxed);
+	while (retired < frame && !m_retired.compare_exchange_weak(retired, frame, std::memory_order_release, std::memory_order_relaxed))
+		;
+}
+
+void RingFrameAllocator::SetReclaimCallback(ReclaimCallback callback, void* userData)
+{
+	m_callback = callback;
+	m_userData = userData;
+}
+
+long long RingFrameAllocator::GetFrame() const
+{
+	return m_frame;
+}
+
+unsigned int RingFrameAllocator::GetFrameCount() const
+{
+	return m_frameCount;
+}
+
+
+DoubleBufferedAllocator::DoubleBufferedAllocator(size_t frameSize_bytes)
+	: RingFrameAllocator(frameSize_bytes, 2)
+{}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include "StackAllocator.h"
+
+/*
+	Ring of N frame sized stacks for data that has to outlive the frame it was made in,
+	like render data handed to a consumer thread.
+
+	Frame f allocates from region f % N. When frame f begins, the region last used by
+	frame f - N is reclaimed, but only after consumers have retired that frame. Until
+	then BeginFrame waits. Consumers retire frames in order from any thread.
+
+	BeginFrame and Alloc belong to the producing thread.
+*/
+class RingFrameAllocator
+{
+public:
+	// Called with the frame number when the region of a retired frame is reclaimed.
+	typedef void (*ReclaimCallback)(long long frame, void* userData);
+
+	RingFrameAllocator(size_t frameSize_bytes, unsigned int frameCount);
+	~RingFrameAllocator();
+
+	// Moves on to the next frame. The first call starts frame 0.
+	void BeginFrame();
+	void* Alloc(size_t size_bytes, size_t align = 1);
+
+	// Fence signalled by consumers: every frame up to and including frame is done with.
+	void Retire(long long frame);
+
+	void SetReclaimCallback(ReclaimCallback callback, void* userData);
+
+	long long GetFrame() const;
+	unsigned int GetFrameCount() const;
+
+private:
+	RingFrameAllocator(const RingFrameAllocator&);
+	RingFrameAllocator& operator=(const RingFrameAllocator&);
+
+	StackAllocator** m_frames;
+	unsigned int m_frameCount;
+
+	long long m_frame;
+	std::atomic<long long> m_retired;
+
+	ReclaimCallback m_callback;
+	void* m_userData;
+};
+
+/*
+	Two frame ring: data made in one frame stays valid through the next.
+*/
+class DoubleBufferedAllocator : public RingFrameAllocator
+{
+public:
+	DoubleBufferedAllocator(size_t frameSize_bytes);
+};
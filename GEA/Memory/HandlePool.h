@@ -0,0 +1,132 @@
+#pragma once
+
+#include <malloc.h>
+#include <cassert>
+
+/*
+	Pool of T slots addressed by 32-bit handles instead of pointers.
+
+	A handle packs the slot index with the generation of the slot when it was handed out.
+	Freeing a slot bumps its generation, so handles to freed slots resolve to nullptr
+	instead of to whatever lives there now. Slots are raw storage like PoolAllocator
+	elements, construct into Get(handle) with placement new.
+*/
+template <typename T>
+class HandlePool
+{
+public:
+	typedef unsigned int Handle;
+
+	static const unsigned INDEX_BITS = 20;
+	static const unsigned INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static const unsigned GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+	static const Handle INVALID_HANDLE = 0;
+
+	HandlePool(unsigned capacity);
+	~HandlePool();
+
+	// Returns INVALID_HANDLE when the pool is full.
+	Handle Alloc();
+	void Free(Handle handle);
+
+	// O(1), returns nullptr for stale or invalid handles.
+	T* Get(Handle handle) const;
+	bool IsValid(Handle handle) const;
+
+	unsigned GetCapacity() const;
+
+private:
+	HandlePool(const HandlePool&);
+	HandlePool& operator=(const HandlePool&);
+
+	static const unsigned NULL_INDEX = 0xFFFFFFFF;
+
+	unsigned& NextOf(unsigned index) const;
+
+	T* m_items;
+	unsigned short* m_generations;
+	unsigned m_capacity;
+	unsigned m_next;
+};
+
+template <typename T>
+HandlePool<T>::HandlePool(unsigned capacity)
+	: m_items(nullptr), m_generations(nullptr), m_capacity(capacity), m_next(NULL_INDEX)
+{
+	assert(sizeof(T) >= sizeof(unsigned) && "Slot too small to hold a free list index");
+	assert(capacity <= INDEX_MASK + 1 && "Capacity exceeds the handle index range");
+
+	m_items = (T*)malloc(sizeof(T) * capacity);
+	m_generations = (unsigned short*)malloc(sizeof(unsigned short) * capacity);
+
+	// Generation 0 is never handed out, which keeps handle 0 invalid.
+	for (unsigned i = 0; i < capacity; ++i)
+	{
+		m_generations[i] = 1;
+		NextOf(i) = (i + 1 < capacity) ? i + 1 : NULL_INDEX;
+	}
+
+	if (capacity > 0)
+		m_next = 0;
+}
+
+template <typename T>
+HandlePool<T>::~HandlePool()
+{
+	free(m_items);
+	free(m_generations);
+}
+
+template <typename T>
+unsigned& HandlePool<T>::NextOf(unsigned index) const
+{
+	return *(unsigned*)&m_items[index];
+}
+
+template <typename T>
+typename HandlePool<T>::Handle HandlePool<T>::Alloc()
+{
+	if (m_next == NULL_INDEX)
+		return INVALID_HANDLE;
+
+	unsigned index = m_next;
+	m_next = NextOf(index);
+
+	return ((Handle)m_generations[index] << INDEX_BITS) | index;
+}
+
+template <typename T>
+void HandlePool<T>::Free(Handle handle)
+{
+	assert(IsValid(handle) && "Freeing a stale or invalid handle");
+
+	unsigned index = handle & INDEX_MASK;
+
+	unsigned short generation = (m_generations[index] + 1) & GENERATION_MASK;
+	m_generations[index] = generation ? generation : 1;
+
+	NextOf(index) = m_next;
+	m_next = index;
+}
+
+template <typename T>
+T* HandlePool<T>::Get(Handle handle) const
+{
+	unsigned index = handle & INDEX_MASK;
+	if (index >= m_capacity || m_generations[index] != (handle >> INDEX_BITS))
+		return nullptr;
+
+	return &m_items[index];
+}
+
+template <typename T>
+bool HandlePool<T>::IsValid(Handle handle) const
+{
+	return Get(handle) != nullptr;
+}
+
+template <typename T>
+unsigned HandlePool<T>::GetCapacity() const
+{
+	return m_capacity;
+}
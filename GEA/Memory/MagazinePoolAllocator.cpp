@@ -0,0 +1,106 @@
+#include "MagazinePoolAllocator.h"
+#include <cassert>
+
+MagazinePoolAllocator::MagazinePoolAllocator(unsigned elementSize, unsigned numElements)
+	: allocator(elementSize, numElements)
+{
+
+}
+
+unsigned MagazinePoolAllocator::AllocBatch(void** out, unsigned count)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return allocator.AllocN(out, count);
+}
+
+void MagazinePoolAllocator::FreeBatch(void** ptrs, unsigned count)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	allocator.FreeN(ptrs, count);
+}
+
+
+PoolMagazine::PoolMagazine(MagazinePoolAllocator& depot, unsigned capacity)
+	: m_depot(depot), m_items(nullptr), m_capacity(capacity), m_count(0), m_requests(0), m_hits(0)
+{
+	assert(capacity >= 2 && "Magazine needs room for at least two elements");
+
+	m_items = new void*[capacity];
+}
+
+PoolMagazine::~PoolMagazine()
+{
+	Flush();
+	delete [] m_items;
+}
+
+void* PoolMagazine::Alloc()
+{
+	m_requests++;
+
+	if (m_count == 0)
+	{
+		m_count = m_depot.AllocBatch(m_items, m_capacity / 2);
+
+		// Depot exhausted, return nullptr like PoolAllocator.
+		if (m_count == 0)
+			return nullptr;
+	}
+	else
+	{
+		m_hits++;
+	}
+
+	return m_items[--m_count];
+}
+
+void PoolMagazine::Free(void* ptr)
+{
+	m_requests++;
+
+	if (m_count == m_capacity)
+	{
+		// Flush the older half and keep the recently freed (cache-warm) elements.
+		unsigned half = m_capacity / 2;
+		m_depot.FreeBatch(m_items, half);
+
+		for (unsigned i = half; i < m_count; ++i)
+			m_items[i - half] = m_items[i];
+		m_count -= half;
+	}
+	else
+	{
+		m_hits++;
+	}
+
+	m_items[m_count++] = ptr;
+}
+
+void PoolMagazine::Flush()
+{
+	m_depot.FreeBatch(m_items, m_count);
+	m_count = 0;
+}
+
+double PoolMagazine::GetHitRate() const
+{
+	return m_requests == 0 ? 0.0 : double(m_hits) / double(m_requests);
+}
+
+unsigned PoolMagazine::AllocN(void** out, unsigned count)
+{
+	// Stop at the first failure and return how many were handed out.
+	for (unsigned i = 0; i < count; ++i)
+	{
+		out[i] = Alloc();
+		if (out[i] == nullptr)
+			return i;
+	}
+	return count;
+}
+
+void PoolMagazine::FreeN(void** ptrs, unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i)
+		Free(ptrs[i]);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <mutex>
+#include "PoolAllocator.h"
+
+/*
+	Shared depot behind the per-thread PoolMagazine caches.
+
+	Elements only move in and out of the depot in batches, so the lock is taken
+	once per refill or flush instead of once per Alloc/Free.
+*/
+class MagazinePoolAllocator
+{
+public:
+	MagazinePoolAllocator(unsigned elementSize, unsigned numElements);
+
+	// Fills out with up to count elements and returns how many were handed out.
+	unsigned AllocBatch(void** out, unsigned count);
+	void FreeBatch(void** ptrs, unsigned count);
+
+private:
+	std::mutex mtx;
+	PoolAllocator allocator;
+};
+
+/*
+	Per-thread magazine of free elements in front of a MagazinePoolAllocator.
+
+	Alloc and Free only touch the local magazine. When it runs empty or full,
+	half a magazine is refilled from or flushed to the depot.
+	Owned and used by a single thread.
+*/
+class PoolMagazine
+{
+public:
+	PoolMagazine(MagazinePoolAllocator& depot, unsigned capacity = 64);
+	~PoolMagazine();
+
+	void* Alloc();
+	void Free(void* ptr);
+
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
+
+	// Returns every cached element to the depot.
+	void Flush();
+
+	// Fraction of Alloc/Free calls served without touching the depot.
+	double GetHitRate() const;
+
+private:
+	MagazinePoolAllocator& m_depot;
+	void** m_items;
+	unsigned m_capacity;
+	unsigned m_count;
+
+	unsigned long long m_requests;
+	unsigned long long m_hits;
+};
@@ -0,0 +1,93 @@
+#include "OwnerPoolAllocator.h"
+
+OwnerPoolAllocator::OwnerPoolAllocator(unsigned elementSize, unsigned numElements)
+	: allocator(elementSize, numElements), m_reclaims(0), m_reclaimed(0), m_remote(nullptr)
+{
+
+}
+
+void* OwnerPoolAllocator::Alloc()
+{
+	void* ptr = allocator.Alloc();
+	if (ptr == nullptr && Reclaim())
+		ptr = allocator.Alloc();
+	return ptr;
+}
+
+void OwnerPoolAllocator::Free(void* ptr)
+{
+	allocator.Free(ptr);
+}
+
+unsigned OwnerPoolAllocator::AllocN(void** out, unsigned count)
+{
+	unsigned n = allocator.AllocN(out, count);
+	if (n < count && Reclaim())
+		n += allocator.AllocN(out + n, count - n);
+	return n;
+}
+
+void OwnerPoolAllocator::FreeN(void** ptrs, unsigned count)
+{
+	allocator.FreeN(ptrs, count);
+}
+
+void OwnerPoolAllocator::RemoteFree(void* ptr)
+{
+	PoolElement* element = (PoolElement*)ptr;
+
+	// Push only, the owner never pops single elements, so there is no ABA to guard against.
+	PoolElement* head = m_remote.load(std::memory_order_relaxed);
+	do
+	{
+		element->m_next = head;
+	} while (!m_remote.compare_exchange_weak(head, element, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void OwnerPoolAllocator::RemoteFreeN(void** ptrs, unsigned count)
+{
+	if (count == 0)
+		return;
+
+	PoolElement* first = (PoolElement*)ptrs[0];
+	PoolElement* last = (PoolElement*)ptrs[count - 1];
+	for (unsigned i = 0; i + 1 < count; ++i)
+		((PoolElement*)ptrs[i])->m_next = (PoolElement*)ptrs[i + 1];
+
+	PoolElement* head = m_remote.load(std::memory_order_relaxed);
+	do
+	{
+		last->m_next = head;
+	} while (!m_remote.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool OwnerPoolAllocator::Reclaim()
+{
+	PoolElement* first = m_remote.exchange(nullptr, std::memory_order_acquire);
+	if (first == nullptr)
+		return false;
+
+	unsigned long long count = 1;
+	PoolElement* last = first;
+	while (last->m_next != nullptr)
+	{
+		last = last->m_next;
+		count++;
+	}
+
+	allocator.FreeChain(first, last);
+
+	m_reclaims++;
+	m_reclaimed += count;
+	return true;
+}
+
+unsigned long long OwnerPoolAllocator::GetReclaimCount() const
+{
+	return m_reclaims;
+}
+
+unsigned long long OwnerPoolAllocator::GetReclaimedCount() const
+{
+	return m_reclaimed;
+}
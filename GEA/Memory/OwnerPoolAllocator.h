@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include "PoolAllocator.h"
+
+/*
+	Pool owned by one thread that any thread may free into.
+
+	Alloc and Free are for the owner only and cost the same as on a PoolAllocator.
+	Other threads return elements through RemoteFree, which pushes them onto a
+	lock-free list. When the owner's own free list runs dry it takes the whole
+	remote list with a single exchange, so neither side ever waits on a lock.
+*/
+class OwnerPoolAllocator
+{
+public:
+	OwnerPoolAllocator(unsigned elementSize, unsigned numElements);
+
+	// Owner thread only.
+	void* Alloc();
+	void Free(void* ptr);
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
+
+	// Any thread.
+	void RemoteFree(void* ptr);
+	void RemoteFreeN(void** ptrs, unsigned count);
+
+	// How often the owner emptied the remote list, and how many elements that gave back.
+	unsigned long long GetReclaimCount() const;
+	unsigned long long GetReclaimedCount() const;
+
+private:
+	// Moves every remotely freed element to the owner's free list. Returns false if there were none.
+	bool Reclaim();
+
+	PoolAllocator allocator;
+	unsigned long long m_reclaims;
+	unsigned long long m_reclaimed;
+
+	// Keeps the remote list head off the cache line the owner works on.
+	char m_padding[64];
+	std::atomic<PoolElement*> m_remote;
+};
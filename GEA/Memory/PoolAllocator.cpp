@@ -1,25 +1,33 @@
 #include "PoolAllocator.h"
+#include "../Profiler.h"
 #include <malloc.h>
 #include <cassert>
 
-PoolAllocator::PoolAllocator(unsigned elementSize, unsigned numElements)
-	: m_start(nullptr), m_next(nullptr)
+PoolAllocator::PoolAllocator(unsigned elementSize, unsigned numElements, PoolGrowth growth, unsigned maxElements, PoolInit init, BackingStore* store)
+	: m_chunks(nullptr), m_next(nullptr), m_bump(nullptr), m_bumpEnd(nullptr), m_elementSize(elementSize), m_chunkElements(numElements),
+	m_capacity(0), m_maxElements(maxElements), m_growth(growth), m_init(init), m_store(store ? store : &BackingStore::Default())
 {
-	m_start = (PoolElement*)malloc( elementSize * numElements );
+	assert(elementSize >= sizeof(PoolElement) && "Element too small to hold a free list link");
+	assert((maxElements == 0 || maxElements >= numElements) && "Initial size exceeds the cap");
 
-	Initialize(elementSize, numElements);
+	Grow();
 }
 
 PoolAllocator::~PoolAllocator()
 {
-    if(m_start != 0) {
-        free(m_start);
-        m_start = 0;
-    }
+	Free();
 }
 
-void PoolAllocator::Initialize(unsigned elementSize, unsigned numElements)
+void PoolAllocator::Initialize(PoolChunk* chunk)
 {
+	if (m_init == POOL_INIT_LAZY)
+	{
+		// Leave the memory untouched, Alloc bumps through it on demand.
+		m_bump = (char*)chunk + POOL_CHUNK_HEADER_SIZE;
+		m_bumpEnd = m_bump + (size_t)m_elementSize * chunk->m_numElements;
+		return;
+	}
+
 	union 
 	{
 		void* as_void;
@@ -27,43 +35,102 @@ void PoolAllocator::Initialize(unsigned elementSize, unsigned numElements)
 		PoolElement* as_self;
 	};
 
-	as_void = m_start;
-	m_next = as_self;
+	as_char = (char*)chunk + POOL_CHUNK_HEADER_SIZE;
+	PoolElement* first = as_self;
 
-	PoolElement* runner = m_next;
-	for(unsigned i = 0; i < numElements; ++i)
+	PoolElement* runner = first;
+	for(unsigned i = 0; i < chunk->m_numElements; ++i)
 	{	
 		runner->m_next = as_self;
 		runner = as_self;
-		as_char += elementSize;
+		as_char += m_elementSize;
 	}
 
-	runner->m_next = nullptr;
+	// Splice the new elements in front of whatever is left of the free list.
+	runner->m_next = m_next;
+	m_next = first;
 };
 
+bool PoolAllocator::Grow()
+{
+	unsigned count = m_chunkElements;
+	if (m_chunks != nullptr)
+	{
+		if (m_growth == POOL_GROWTH_NONE)
+			return false;
+		if (m_growth == POOL_GROWTH_GEOMETRIC)
+			count = m_capacity;
+	}
+
+	if (m_maxElements != 0)
+	{
+		if (m_capacity >= m_maxElements)
+			return false;
+		if (count > m_maxElements - m_capacity)
+			count = m_maxElements - m_capacity;
+	}
+
+	if (count == 0)
+		return false;
+
+	PoolChunk* chunk = (PoolChunk*)m_store->Allocate( POOL_CHUNK_HEADER_SIZE + (size_t)m_elementSize * count );
+	if (chunk == nullptr)
+		return false;
+
+	chunk->m_next = m_chunks;
+	chunk->m_numElements = count;
+	m_chunks = chunk;
+	m_capacity += count;
+
+	Initialize(chunk);
+	return true;
+}
+
 void PoolAllocator::Free()
 {
-    free(m_start);
+	while (m_chunks != nullptr)
+	{
+		PoolChunk* next = m_chunks->m_next;
+		m_store->Release(m_chunks, POOL_CHUNK_HEADER_SIZE + (size_t)m_elementSize * m_chunks->m_numElements);
+		m_chunks = next;
+	}
+
+	m_next = nullptr;
+	m_bump = nullptr;
+	m_bumpEnd = nullptr;
+	m_capacity = 0;
 }
 
 void* PoolAllocator::Alloc()
 {
-	assert(m_next != nullptr);
-		
 	PoolElement* head = m_next;
+	if (head == nullptr)
+		return AllocSlow();
+
 	m_next = head->m_next;
 	return head;
+}
 
-	/*
-	// Reached the end of list return nullptr.
-	if (m_next == nullptr) {
-		return nullptr;
+// Kept out of Alloc so the common path stays a single pointer pop.
+void* PoolAllocator::AllocSlow()
+{
+	if (m_bump != m_bumpEnd)
+	{
+		void* ptr = m_bump;
+		m_bump += m_elementSize;
+		return ptr;
 	}
- 
+
+	// Reached the end of list and can't grow, return nullptr.
+	if (!Grow())
+		return nullptr;
+
+	if (m_init == POOL_INIT_LAZY)
+		return AllocSlow();
+
 	PoolElement* head = m_next;
 	m_next = head->m_next;
 	return head;
-	*/
 }
  
 void PoolAllocator::Free(void* ptr)
@@ -74,6 +141,68 @@ void PoolAllocator::Free(void* ptr)
 	m_next = head;
 }
 
+unsigned PoolAllocator::AllocN(void** out, unsigned count)
+{
+	PROFILE_ZONE("PoolAllocator::AllocN");
+	unsigned n = 0;
+
+	// Detach the front of the free list in one go.
+	PoolElement* head = m_next;
+	while (n < count && head != nullptr)
+	{
+		out[n++] = head;
+		head = head->m_next;
+	}
+	m_next = head;
+
+	// Lazy elements and growth.
+	while (n < count)
+	{
+		void* ptr = AllocSlow();
+		if (ptr == nullptr)
+			break;
+		out[n++] = ptr;
+	}
+
+	return n;
+}
+
+// Links ptrs[0] to ptrs[count - 1] into a chain, the last link is left to the caller.
+static void LinkElements(void** ptrs, unsigned count)
+{
+	for (unsigned i = 0; i + 1 < count; ++i)
+		((PoolElement*)ptrs[i])->m_next = (PoolElement*)ptrs[i + 1];
+}
+
+void PoolAllocator::FreeN(void** ptrs, unsigned count)
+{
+	PROFILE_ZONE("PoolAllocator::FreeN");
+	if (count == 0)
+		return;
+
+	LinkElements(ptrs, count);
+	FreeChain((PoolElement*)ptrs[0], (PoolElement*)ptrs[count - 1]);
+}
+
+void PoolAllocator::FreeChain(PoolElement* first, PoolElement* last)
+{
+	last->m_next = m_next;
+	m_next = first;
+}
+
+unsigned PoolAllocator::GetCapacity() const
+{
+	return m_capacity;
+}
+
+unsigned PoolAllocator::GetChunkCount() const
+{
+	unsigned count = 0;
+	for (PoolChunk* chunk = m_chunks; chunk != nullptr; chunk = chunk->m_next)
+		count++;
+	return count;
+}
+
 ThreadedPoolAllocator::ThreadedPoolAllocator(unsigned elementSize, unsigned numElements)
 	: allocator(elementSize, numElements)
 {
@@ -92,6 +221,151 @@ void ThreadedPoolAllocator::Free(void* ptr)
 	allocator.Free(ptr);
 }
 
+unsigned ThreadedPoolAllocator::AllocN(void** out, unsigned count)
+{
+	PROFILE_ZONE("ThreadedPoolAllocator::AllocN");
+	std::lock_guard<std::mutex> lock(mtx);
+	return allocator.AllocN(out, count);
+}
+
+void ThreadedPoolAllocator::FreeN(void** ptrs, unsigned count)
+{
+	if (count == 0)
+		return;
+
+	PROFILE_ZONE("ThreadedPoolAllocator::FreeN");
+
+	// The elements belong to this thread until they are spliced in, link them outside the lock.
+	LinkElements(ptrs, count);
+
+	std::lock_guard<std::mutex> lock(mtx);
+	allocator.FreeChain((PoolElement*)ptrs[0], (PoolElement*)ptrs[count - 1]);
+}
+
+LockFreePoolAllocator::LockFreePoolAllocator(unsigned elementSize, unsigned numElements)
+	: m_start(nullptr), m_elementSize(elementSize), m_numElements(numElements), m_head(0)
+{
+	assert(elementSize >= sizeof(unsigned) && "Element too small to hold a free list index");
+
+	m_start = (char*)malloc( elementSize * numElements );
+
+	for(unsigned i = 0; i < numElements; ++i)
+		NextOf(i) = (i + 1 < numElements) ? i + 1 : NULL_INDEX;
+
+	m_head.store(numElements > 0 ? 0 : NULL_INDEX);
+}
+
+LockFreePoolAllocator::~LockFreePoolAllocator()
+{
+	if(m_start != 0) {
+		free(m_start);
+		m_start = 0;
+	}
+}
+
+unsigned& LockFreePoolAllocator::NextOf(unsigned index) const
+{
+	return *(unsigned*)(m_start + (size_t)index * m_elementSize);
+}
+
+void* LockFreePoolAllocator::Alloc()
+{
+	unsigned long long head = m_head.load(std::memory_order_acquire);
+	for(;;)
+	{
+		unsigned index = (unsigned)head;
+		if(index == NULL_INDEX)
+			return nullptr;
+
+		// The element may be popped and overwritten by another thread before the CAS,
+		// in which case the tag has moved on and the stale next index is discarded.
+		unsigned long long tag = (head >> 32) + 1;
+		unsigned long long next = (tag << 32) | NextOf(index);
+
+		if(m_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+			return m_start + (size_t)index * m_elementSize;
+	}
+}
+
+void LockFreePoolAllocator::Free(void* ptr)
+{
+	unsigned index = (unsigned)(((char*)ptr - m_start) / m_elementSize);
+	assert(index < m_numElements && "Pointer does not belong to this pool");
+
+	unsigned long long head = m_head.load(std::memory_order_relaxed);
+	for(;;)
+	{
+		NextOf(index) = (unsigned)head;
+
+		unsigned long long tag = (head >> 32) + 1;
+		unsigned long long next = (tag << 32) | index;
+
+		if(m_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed))
+			return;
+	}
+}
+
+unsigned LockFreePoolAllocator::AllocN(void** out, unsigned count)
+{
+	unsigned long long head = m_head.load(std::memory_order_acquire);
+	for(;;)
+	{
+		// Walk the segment to detach. If anything popped or pushed meanwhile the links
+		// read here may be garbage, but then the tag has moved on and the CAS fails.
+		unsigned n = 0;
+		unsigned index = (unsigned)head;
+		while(n < count && index < m_numElements)
+		{
+			out[n++] = m_start + (size_t)index * m_elementSize;
+			index = NextOf(index);
+		}
+
+		if(index != NULL_INDEX && index >= m_numElements)
+		{
+			head = m_head.load(std::memory_order_acquire);
+			continue;
+		}
+
+		if(n == 0)
+			return 0;
+
+		unsigned long long tag = (head >> 32) + 1;
+		unsigned long long next = (tag << 32) | index;
+
+		if(m_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+			return n;
+	}
+}
+
+void LockFreePoolAllocator::FreeN(void** ptrs, unsigned count)
+{
+	if(count == 0)
+		return;
+
+	unsigned first = (unsigned)(((char*)ptrs[0] - m_start) / m_elementSize);
+	unsigned last = first;
+	for(unsigned i = 1; i < count; ++i)
+	{
+		unsigned index = (unsigned)(((char*)ptrs[i] - m_start) / m_elementSize);
+		assert(index < m_numElements && "Pointer does not belong to this pool");
+
+		NextOf(last) = index;
+		last = index;
+	}
+
+	unsigned long long head = m_head.load(std::memory_order_relaxed);
+	for(;;)
+	{
+		NextOf(last) = (unsigned)head;
+
+		unsigned long long tag = (head >> 32) + 1;
+		unsigned long long next = (tag << 32) | first;
+
+		if(m_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed))
+			return;
+	}
+}
+
 
 DefaultMemoryManager::DefaultMemoryManager(unsigned elementSize)
 {
@@ -108,3 +382,15 @@ void DefaultMemoryManager::Free(void* ptr)
 	free(ptr);
 }
 
+unsigned DefaultMemoryManager::AllocN(void** out, unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i)
+		out[i] = malloc(elementSize);
+	return count;
+}
+
+void DefaultMemoryManager::FreeN(void** ptrs, unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i)
+		free(ptrs[i]);
+}
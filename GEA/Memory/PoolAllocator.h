@@ -1,27 +1,79 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
+#include "BackingStore.h"
 
 struct PoolElement
 {
 	PoolElement* m_next;
 };
 
+// Header in front of every block of elements owned by a PoolAllocator.
+struct PoolChunk
+{
+	PoolChunk* m_next;
+	unsigned m_numElements;
+};
+
+// Elements start this far into a chunk so they keep malloc's alignment.
+static const unsigned POOL_CHUNK_HEADER_SIZE = (sizeof(PoolChunk) + 15) & ~15;
+
+enum PoolGrowth
+{
+	POOL_GROWTH_NONE,		// Alloc returns nullptr once the first chunk is used up.
+	POOL_GROWTH_FIXED,		// Every new chunk holds as many elements as the first.
+	POOL_GROWTH_GEOMETRIC	// Every new chunk holds as many elements as the whole pool so far.
+};
+
+enum PoolInit
+{
+	POOL_INIT_EAGER,	// Every element is linked into the free list when its chunk is created.
+	POOL_INIT_LAZY		// Untouched elements are bumped out of the chunk, only freed ones are linked.
+};
+
 class PoolAllocator
 {
 public:
-	PoolAllocator(unsigned elementSize, unsigned numElements);
+	// maxElements caps the total number of elements the pool may grow to, 0 means no cap.
+	// Chunks come from store, or from BackingStore::Default() if it is nullptr.
+	PoolAllocator(unsigned elementSize, unsigned numElements, PoolGrowth growth = POOL_GROWTH_NONE, unsigned maxElements = 0,
+		PoolInit init = POOL_INIT_EAGER, BackingStore* store = nullptr);
 	~PoolAllocator();
 
+	// Releases every chunk. Elements handed out before must not be used afterwards.
 	void Free();
 	void* Alloc();
 	void Free(void* ptr);
 
+	// Fills out with up to count elements and returns how many were handed out.
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
+	// Puts back a chain of elements already linked through PoolElement::m_next.
+	void FreeChain(PoolElement* first, PoolElement* last);
+
+	unsigned GetCapacity() const;
+	unsigned GetChunkCount() const;
+
 private:
-	void Initialize(unsigned elementSize, unsigned numElements);
+	void* AllocSlow();
+	bool Grow();
+	void Initialize(PoolChunk* chunk);
 
-	PoolElement* m_start;
+	PoolChunk* m_chunks;
 	PoolElement* m_next;
+
+	// Never-touched elements of the newest chunk, only used with POOL_INIT_LAZY.
+	char* m_bump;
+	char* m_bumpEnd;
+
+	unsigned m_elementSize;
+	unsigned m_chunkElements;
+	unsigned m_capacity;
+	unsigned m_maxElements;
+	PoolGrowth m_growth;
+	PoolInit m_init;
+	BackingStore* m_store;
 };
 
 class ThreadedPoolAllocator
@@ -30,17 +82,55 @@ public:
 	ThreadedPoolAllocator(unsigned elementSize, unsigned numElements);
 	void* Alloc();
 	void Free(void* ptr);
+
+	// One lock per batch. FreeN links the batch before taking the lock and splices it in whole.
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
 private:
 	std::mutex mtx;
 	PoolAllocator allocator;
 };
 
+/*
+	Lock-free pool shared between threads.
+
+	The free list is a Treiber stack of element indices. The head packs a 32-bit
+	tag next to the index and the tag is bumped on every successful CAS, so a
+	head that was popped and pushed back in between is not mistaken for the same head (ABA).
+*/
+class LockFreePoolAllocator
+{
+public:
+	LockFreePoolAllocator(unsigned elementSize, unsigned numElements);
+	~LockFreePoolAllocator();
+
+	void* Alloc();
+	void Free(void* ptr);
+
+	// Detach or push a whole segment of the free list with a single CAS.
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
+
+private:
+	static const unsigned NULL_INDEX = 0xFFFFFFFF;
+
+	unsigned& NextOf(unsigned index) const;
+
+	char* m_start;
+	unsigned m_elementSize;
+	unsigned m_numElements;
+	std::atomic<unsigned long long> m_head;
+};
+
 class DefaultMemoryManager 
 {
 public:
 	DefaultMemoryManager(unsigned elementSize);
 	void* Alloc();
 	void Free(void* ptr);
+
+	unsigned AllocN(void** out, unsigned count);
+	void FreeN(void** ptrs, unsigned count);
 private:
 	unsigned elementSize;
 };
\ No newline at end of file
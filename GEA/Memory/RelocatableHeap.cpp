@@ -0,0 +1,275 @@
+#include "RelocatableHeap.h"
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+// Out-of-line definition, the constant is bound to references (e.g. std::vector fill values).
+const RelocatableHeap::Handle RelocatableHeap::INVALID_HANDLE;
+
+RelocatableHeap::RelocatableHeap(size_t size_bytes, unsigned maxBlocks)
+	: m_mem(nullptr), m_base(nullptr), m_end(nullptr), m_top(nullptr), m_topPrevSize(0), m_cursor(nullptr), m_freeList(nullptr), m_freeCount(0), m_usedSize(0), m_handles(maxBlocks)
+{
+	assert(sizeof(Block) == 16 && "Header must keep payloads aligned");
+	assert(size_bytes <= 0xFFFFFFFFu && "Block sizes are 32-bit");
+
+	m_mem = (char*)malloc(size_bytes + ALIGN);
+	m_base = (char*)(((size_t)m_mem + ALIGN - 1) & ~(size_t)(ALIGN - 1));
+	m_end = m_base + (size_bytes & ~(size_t)(ALIGN - 1));
+	m_top = m_base;
+	m_cursor = m_base;
+}
+
+RelocatableHeap::~RelocatableHeap()
+{
+	free(m_mem);
+}
+
+RelocatableHeap::FreeNode* RelocatableHeap::NodeOf(Block* block)
+{
+	return (FreeNode*)((char*)block + HEADER_SIZE);
+}
+
+RelocatableHeap::Block* RelocatableHeap::Next(Block* block)
+{
+	return (Block*)((char*)block + block->m_size);
+}
+
+RelocatableHeap::Block* RelocatableHeap::Prev(Block* block)
+{
+	return (Block*)((char*)block - block->m_prevSize);
+}
+
+void RelocatableHeap::PushFree(Block* block)
+{
+	FreeNode* node = NodeOf(block);
+	node->m_prev = nullptr;
+	node->m_next = m_freeList;
+	if (m_freeList != nullptr)
+		NodeOf(m_freeList)->m_prev = block;
+	m_freeList = block;
+	m_freeCount++;
+}
+
+void RelocatableHeap::UnlinkFree(Block* block)
+{
+	FreeNode* node = NodeOf(block);
+	if (node->m_prev != nullptr)
+		NodeOf(node->m_prev)->m_next = node->m_next;
+	else
+		m_freeList = node->m_next;
+	if (node->m_next != nullptr)
+		NodeOf(node->m_next)->m_prev = node->m_prev;
+	m_freeCount--;
+}
+
+void RelocatableHeap::SetPrevSize(Block* at, unsigned size)
+{
+	if ((char*)at == m_top)
+		m_topPrevSize = size;
+	else
+		at->m_prevSize = size;
+}
+
+RelocatableHeap::Handle RelocatableHeap::Alloc(size_t size_bytes)
+{
+	size_t need = (size_bytes + ALIGN - 1) / ALIGN * ALIGN + HEADER_SIZE;
+	if (need < MIN_BLOCK_SIZE)
+		need = MIN_BLOCK_SIZE;
+
+	// First fit among the free blocks, then the top.
+	Block* block = m_freeList;
+	while (block != nullptr && block->m_size < need)
+		block = NodeOf(block)->m_next;
+
+	if (block == nullptr && need > (size_t)(m_end - m_top))
+		return INVALID_HANDLE;
+
+	Handle handle = m_handles.Alloc();
+	if (handle == INVALID_HANDLE)
+		return INVALID_HANDLE;
+
+	if (block != nullptr)
+	{
+		UnlinkFree(block);
+
+		// Split off the tail if it can stand on its own.
+		if (block->m_size - need >= MIN_BLOCK_SIZE)
+		{
+			Block* rest = (Block*)((char*)block + need);
+			rest->m_size = block->m_size - (unsigned)need;
+			rest->m_prevSize = (unsigned)need;
+			rest->m_flags = BLOCK_FREE;
+			SetPrevSize(Next(rest), rest->m_size);
+			PushFree(rest);
+
+			block->m_size = (unsigned)need;
+		}
+	}
+	else
+	{
+		block = (Block*)m_top;
+		block->m_size = (unsigned)need;
+		block->m_prevSize = m_topPrevSize;
+		m_top += need;
+		m_topPrevSize = (unsigned)need;
+	}
+
+	block->m_flags = 0;
+	block->m_handle = handle;
+	m_usedSize += block->m_size;
+
+	*m_handles.Get(handle) = (char*)block + HEADER_SIZE;
+	return handle;
+}
+
+void RelocatableHeap::Free(Handle handle)
+{
+	char** slot = m_handles.Get(handle);
+	assert(slot != nullptr && "Freeing a stale or invalid handle");
+
+	Block* block = (Block*)(*slot - HEADER_SIZE);
+	m_handles.Free(handle);
+
+	m_usedSize -= block->m_size;
+	Release(block);
+}
+
+void RelocatableHeap::Release(Block* block)
+{
+	block->m_flags = BLOCK_FREE;
+
+	Block* next = Next(block);
+	if ((char*)next != m_top && (next->m_flags & BLOCK_FREE))
+	{
+		UnlinkFree(next);
+		block->m_size += next->m_size;
+	}
+
+	if (block->m_prevSize != 0)
+	{
+		Block* prev = Prev(block);
+		if (prev->m_flags & BLOCK_FREE)
+		{
+			UnlinkFree(prev);
+			prev->m_size += block->m_size;
+			block = prev;
+		}
+	}
+
+	if ((char*)Next(block) == m_top)
+	{
+		m_top = (char*)block;
+		m_topPrevSize = block->m_prevSize;
+	}
+	else
+	{
+		SetPrevSize(Next(block), block->m_size);
+		PushFree(block);
+	}
+
+	if ((char*)block < m_cursor)
+		m_cursor = (char*)block;
+}
+
+void* RelocatableHeap::Get(Handle handle) const
+{
+	char** slot = m_handles.Get(handle);
+	return slot != nullptr ? *slot : nullptr;
+}
+
+size_t RelocatableHeap::Defragment(size_t maxBytes, double maxMilliseconds)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	size_t moved = 0;
+	while (m_cursor < m_top)
+	{
+		Block* gap = (Block*)m_cursor;
+		if (!(gap->m_flags & BLOCK_FREE))
+		{
+			m_cursor += gap->m_size;
+			continue;
+		}
+
+		// Free neighbours are always merged and a gap below the top is absorbed by it,
+		// so the block after a gap is live.
+		Block* live = Next(gap);
+		unsigned size = live->m_size;
+
+		if (moved > 0)
+		{
+			if (moved + size > maxBytes)
+				break;
+			if (maxMilliseconds > 0.0 && std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= maxMilliseconds)
+				break;
+		}
+
+		unsigned gapSize = gap->m_size;
+		unsigned prevSize = gap->m_prevSize;
+		UnlinkFree(gap);
+
+		// Slide the live block down, header and all, and point its handle at the new place.
+		Block* block = gap;
+		memmove(block, live, size);
+		block->m_prevSize = prevSize;
+		*m_handles.Get(block->m_handle) = (char*)block + HEADER_SIZE;
+
+		// The gap now sits behind the moved block.
+		Block* hole = (Block*)((char*)block + size);
+		hole->m_size = gapSize;
+		hole->m_prevSize = size;
+		hole->m_flags = 0;
+		Release(hole);
+
+		moved += size;
+		m_cursor = (char*)block + size;
+	}
+
+	return moved;
+}
+
+bool RelocatableHeap::IsCompacted() const
+{
+	return m_freeCount == 0;
+}
+
+size_t RelocatableHeap::GetTotalSize() const
+{
+	return m_end - m_base;
+}
+
+size_t RelocatableHeap::GetUsedSize() const
+{
+	return m_usedSize;
+}
+
+size_t RelocatableHeap::GetFreeSize() const
+{
+	return GetTotalSize() - m_usedSize;
+}
+
+size_t RelocatableHeap::GetLargestFreeBlock() const
+{
+	size_t largest = m_end - m_top;
+	for (Block* block = m_freeList; block != nullptr; block = NodeOf(block)->m_next)
+	{
+		if (block->m_size > largest)
+			largest = block->m_size;
+	}
+	return largest;
+}
+
+unsigned RelocatableHeap::GetFreeBlockCount() const
+{
+	return m_freeCount;
+}
+
+double RelocatableHeap::GetFragmentation() const
+{
+	size_t freeSize = GetFreeSize();
+	if (freeSize == 0)
+		return 0.0;
+	return 1.0 - (double)GetLargestFreeBlock() / (double)freeSize;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include "HandlePool.h"
+
+/*
+	Variable-size heap whose blocks are referenced through handles, so they can be moved.
+
+	Blocks sit back to back in one region, with new ones bumped off the top and freed
+	ones merged with free neighbours and reused first fit. Defragment slides live blocks
+	down over the gaps in front of them and patches their handles. It works incrementally
+	from a cursor and stops at a byte or time budget, so it can run a little every frame.
+
+	Pointers from Get are only valid until the next Defragment call.
+*/
+class RelocatableHeap
+{
+public:
+	typedef HandlePool<char*>::Handle Handle;
+	static const Handle INVALID_HANDLE = HandlePool<char*>::INVALID_HANDLE;
+
+	RelocatableHeap(size_t size_bytes, unsigned maxBlocks);
+	~RelocatableHeap();
+
+	// Returns INVALID_HANDLE when there is no room or no free handle.
+	Handle Alloc(size_t size_bytes);
+	void Free(Handle handle);
+	// Returns nullptr for stale or invalid handles.
+	void* Get(Handle handle) const;
+
+	// Moves live blocks down until maxBytes have been copied or maxMilliseconds have passed,
+	// 0 means no time limit. At least one block is moved if there is a gap, even if it is
+	// larger than the budget, so every call makes progress. Returns the bytes moved.
+	size_t Defragment(size_t maxBytes, double maxMilliseconds = 0.0);
+	bool IsCompacted() const;
+
+	size_t GetTotalSize() const;
+	size_t GetUsedSize() const;
+	size_t GetFreeSize() const;
+	// Largest free block, counting the space above the top block.
+	size_t GetLargestFreeBlock() const;
+	unsigned GetFreeBlockCount() const;
+	// Share of free memory that is not in the largest free block, 0 when it is all in one piece.
+	double GetFragmentation() const;
+
+private:
+	RelocatableHeap(const RelocatableHeap&);
+	RelocatableHeap& operator=(const RelocatableHeap&);
+
+	static const unsigned ALIGN = 16;
+	static const unsigned BLOCK_FREE = 1;
+
+	struct Block
+	{
+		// Whole block including this header.
+		unsigned m_size;
+		// Size of the block physically in front, 0 for the first one.
+		unsigned m_prevSize;
+		Handle m_handle;
+		unsigned m_flags;
+	};
+
+	// Lives in the payload of free blocks.
+	struct FreeNode
+	{
+		Block* m_next;
+		Block* m_prev;
+	};
+
+	static const unsigned HEADER_SIZE = sizeof(Block);
+	static const unsigned MIN_BLOCK_SIZE = HEADER_SIZE + (sizeof(FreeNode) + ALIGN - 1) / ALIGN * ALIGN;
+
+	static FreeNode* NodeOf(Block* block);
+	static Block* Next(Block* block);
+	static Block* Prev(Block* block);
+
+	void PushFree(Block* block);
+	void UnlinkFree(Block* block);
+	// Sets the back link of the block starting at at, or of the top if at is the top.
+	void SetPrevSize(Block* at, unsigned size);
+	// Marks block free, merges it with its neighbours and files it or returns it to the top.
+	void Release(Block* block);
+
+	char* m_mem;
+	char* m_base;
+	char* m_end;
+	char* m_top;
+	// Size of the block right below m_top, 0 if there is none.
+	unsigned m_topPrevSize;
+	// No free block starts below the cursor.
+	char* m_cursor;
+
+	Block* m_freeList;
+	unsigned m_freeCount;
+	size_t m_usedSize;
+
+	HandlePool<char*> m_handles;
+};
@@ -0,0 +1,137 @@
+#include "SizeClassAllocator.h"
+#include "VirtualMemory.h"
+#include <malloc.h>
+#include <cassert>
+#include <cstring>
+
+unsigned SizeClassAllocator::ClassSize(unsigned index)
+{
+	// Even indices are powers of two, odd ones sit halfway to the next power of two.
+	unsigned pow2 = MIN_SIZE << (index / 2);
+	return (index & 1) ? pow2 + pow2 / 2 : pow2;
+}
+
+unsigned SizeClassAllocator::ClassIndex(size_t size_bytes) const
+{
+	if (size_bytes <= SMALL_LOOKUP_LIMIT)
+		return m_smallLookup[(size_bytes + 7) / 8];
+	return m_largeLookup[(size_bytes + 511) / 512];
+}
+
+unsigned SizeClassAllocator::GetClassSize(size_t size_bytes) const
+{
+	if (size_bytes > MAX_SIZE)
+		return 0;
+	return ClassSize(ClassIndex(size_bytes));
+}
+
+SizeClassAllocator::SizeClassAllocator(size_t arenaSize_bytes, bool prefault)
+	: m_arena(nullptr), m_arenaStart(nullptr), m_arenaNext(nullptr), m_arenaEnd(nullptr), m_pageMap(nullptr)
+{
+	assert(ClassSize(CLASS_COUNT - 1) == MAX_SIZE);
+
+	// Smallest class that fits each lookup step.
+	unsigned index = 0;
+	for (unsigned i = 0; i < sizeof(m_smallLookup); ++i)
+	{
+		while (ClassSize(index) < i * 8)
+			index++;
+		m_smallLookup[i] = (unsigned char)index;
+	}
+
+	index = 0;
+	for (unsigned i = 0; i < sizeof(m_largeLookup); ++i)
+	{
+		while (ClassSize(index) < i * 512)
+			index++;
+		m_largeLookup[i] = (unsigned char)index;
+	}
+
+	// Align the arena to the span size so a pointer maps straight to its span.
+	size_t spanCount = arenaSize_bytes / SPAN_SIZE;
+	m_arena = (char*)malloc(spanCount * SPAN_SIZE + SPAN_SIZE);
+	m_arenaStart = (char*)(((size_t)m_arena + SPAN_SIZE - 1) & ~(size_t)(SPAN_SIZE - 1));
+	m_arenaNext = m_arenaStart;
+	m_arenaEnd = m_arenaStart + spanCount * SPAN_SIZE;
+
+	if (prefault)
+		VirtualMemory::Prefault(m_arenaStart, spanCount * SPAN_SIZE);
+
+	m_pageMap = new unsigned char[spanCount];
+	memset(m_pageMap, NO_CLASS, spanCount);
+
+	for (unsigned i = 0; i < CLASS_COUNT; ++i)
+	{
+		unsigned size = ClassSize(i);
+
+		// Chunks hold at least eight elements and are rounded up to whole spans.
+		size_t chunkBytes = ((size_t)size * 8 + POOL_CHUNK_HEADER_SIZE + SPAN_SIZE - 1) & ~(size_t)(SPAN_SIZE - 1);
+		unsigned elements = (unsigned)((chunkBytes - POOL_CHUNK_HEADER_SIZE) / size);
+
+		m_stores[i].m_owner = this;
+		m_stores[i].m_class = (unsigned char)i;
+		m_pools[i] = new PoolAllocator(size, elements, POOL_GROWTH_FIXED, 0, POOL_INIT_LAZY, &m_stores[i]);
+	}
+}
+
+SizeClassAllocator::~SizeClassAllocator()
+{
+	for (unsigned i = 0; i < CLASS_COUNT; ++i)
+		delete m_pools[i];
+
+	delete [] m_pageMap;
+	free(m_arena);
+}
+
+void* SizeClassAllocator::Alloc(size_t size_bytes)
+{
+	if (size_bytes > MAX_SIZE)
+		return malloc(size_bytes);
+
+	void* ptr = m_pools[ClassIndex(size_bytes)]->Alloc();
+	return ptr ? ptr : malloc(size_bytes);
+}
+
+void SizeClassAllocator::Free(void* ptr)
+{
+	char* p = (char*)ptr;
+	if (p < m_arenaStart || p >= m_arenaEnd)
+	{
+		free(ptr);
+		return;
+	}
+
+	unsigned char index = m_pageMap[(p - m_arenaStart) / SPAN_SIZE];
+	assert(index != NO_CLASS && "Pointer is in a span no size class owns");
+
+	m_pools[index]->Free(ptr);
+}
+
+size_t SizeClassAllocator::GetArenaSize() const
+{
+	return m_arenaEnd - m_arenaStart;
+}
+
+size_t SizeClassAllocator::GetArenaUsed() const
+{
+	return m_arenaNext - m_arenaStart;
+}
+
+void* SizeClassAllocator::SpanStore::Allocate(size_t size)
+{
+	size_t bytes = (size + SPAN_SIZE - 1) & ~(size_t)(SPAN_SIZE - 1);
+	if (bytes > (size_t)(m_owner->m_arenaEnd - m_owner->m_arenaNext))
+		return nullptr;
+
+	char* ptr = m_owner->m_arenaNext;
+	m_owner->m_arenaNext += bytes;
+
+	memset(m_owner->m_pageMap + (ptr - m_owner->m_arenaStart) / SPAN_SIZE, m_class, bytes / SPAN_SIZE);
+
+	return ptr;
+}
+
+void SizeClassAllocator::SpanStore::Release(void*, size_t)
+{
+	// Spans are only handed back when the whole allocator goes away.
+}
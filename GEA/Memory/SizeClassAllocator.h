@@ -0,0 +1,67 @@
+#pragma once
+
+#include "PoolAllocator.h"
+
+/*
+	General purpose small object allocator built from one PoolAllocator per size class.
+
+	Classes go from 16 B to 32 KB in half power-of-two steps (16, 24, 32, 48, ...).
+	All pools take their chunks from one arena that is split into fixed size spans,
+	and a page map records which class owns each span, so Free doesn't need the size.
+	Requests above the largest class, or made once the arena is used up, go to malloc.
+*/
+class SizeClassAllocator
+{
+public:
+	static const unsigned MIN_SIZE = 16;
+	static const unsigned MAX_SIZE = 32768;
+	static const unsigned CLASS_COUNT = 23;
+	static const unsigned SPAN_SIZE = 65536;
+
+	// prefault touches the whole arena up front, so spans don't page fault on first use.
+	SizeClassAllocator(size_t arenaSize_bytes, bool prefault = false);
+	~SizeClassAllocator();
+
+	void* Alloc(size_t size_bytes);
+	void Free(void* ptr);
+
+	// Size of the class that serves a request, or 0 if it is not served from a class.
+	unsigned GetClassSize(size_t size_bytes) const;
+
+	size_t GetArenaSize() const;
+	size_t GetArenaUsed() const;
+
+private:
+	static const unsigned char NO_CLASS = 0xFF;
+
+	// Hands out arena spans to the pool of one size class and marks them in the page map.
+	class SpanStore : public BackingStore
+	{
+	public:
+		void* Allocate(size_t size);
+		void Release(void* ptr, size_t size);
+
+		SizeClassAllocator* m_owner;
+		unsigned char m_class;
+	};
+
+	// Requests up to SMALL_LOOKUP_LIMIT are looked up in 8 byte steps, larger ones in 512 byte
+	// steps. Each step is the gap between the two smallest classes in its range (16/24 and
+	// 1024/1536), so every class is reachable.
+	static const unsigned SMALL_LOOKUP_LIMIT = 1024;
+
+	unsigned ClassIndex(size_t size_bytes) const;
+	static unsigned ClassSize(unsigned index);
+
+	unsigned char m_smallLookup[SMALL_LOOKUP_LIMIT / 8 + 1];
+	unsigned char m_largeLookup[MAX_SIZE / 512 + 1];
+
+	char* m_arena;
+	char* m_arenaStart;
+	char* m_arenaNext;
+	char* m_arenaEnd;
+	unsigned char* m_pageMap;
+
+	SpanStore m_stores[CLASS_COUNT];
+	PoolAllocator* m_pools[CLASS_COUNT];
+};
@@ -2,27 +2,29 @@
 #include <iostream>
 #include <assert.h>
 
-StackAllocator::StackAllocator( unsigned int stackSize_bytes )
-: m_stackSize_bytes(stackSize_bytes)
+StackAllocator::StackAllocator( size_t stackSize_bytes, BackingStore* store )
+: m_stackSize_bytes(stackSize_bytes), m_store(store ? store : &BackingStore::Default())
 {
-    m_mem = malloc( stackSize_bytes );
+    m_mem = m_store->Allocate( stackSize_bytes );
     m_ptr = m_mem;
 }
 
 StackAllocator::~StackAllocator()
 {
     if(m_mem != 0) {
-        free(m_mem);
+        m_store->Release(m_mem, m_stackSize_bytes);
         m_mem = 0;
     }
 }
 
-void* StackAllocator::Alloc( unsigned int size_bytes )
+void* StackAllocator::Alloc( size_t size_bytes, size_t align )
 {
-    assert(m_ptr < ((char*)m_mem + m_stackSize_bytes) && "Stack allocator overflow");
+    assert((align & (align - 1)) == 0 && "Alignment must be a power of two");
 
-    void* ptr = m_ptr;
-    m_ptr = (char*)m_ptr + size_bytes;
+    char* ptr = (char*)(((size_t)m_ptr + align - 1) & ~(size_t)(align - 1));
+    assert(ptr + size_bytes <= ((char*)m_mem + m_stackSize_bytes) && "Stack allocator overflow");
+
+    m_ptr = ptr + size_bytes;
 
     return ptr;
 }
@@ -32,29 +34,137 @@ void StackAllocator::Clear(  )
     m_ptr = m_mem;
 }
 
-unsigned int StackAllocator::GetTotalSize() const
+StackAllocator::Marker StackAllocator::GetMarker() const
+{
+    return (char*)m_ptr - (char*)m_mem;
+}
+
+void StackAllocator::FreeToMarker( Marker marker )
+{
+    assert(marker <= GetMarker() && "Marker is above the top of the stack");
+
+    m_ptr = (char*)m_mem + marker;
+}
+
+size_t StackAllocator::GetTotalSize() const
 {
     return m_stackSize_bytes;
 }
 
-unsigned int StackAllocator::GetAllocatedSize() const
+size_t StackAllocator::GetAllocatedSize() const
 {
-    return ((int)m_ptr - (int)m_mem);
+    return (char*)m_ptr - (char*)m_mem;
 }
 
 
 
-StackMemoryManager::StackMemoryManager(unsigned int stackSize_bytes)
-	: allocator(stackSize_bytes)
-{}
+StackMemoryManager::StackMemoryManager(size_t stackSize_bytes, StackSync sync, BackingStore* store)
+	: allocator(stackSize_bytes, store), m_sync(sync), m_base(nullptr), m_size(stackSize_bytes), m_top(0)
+{
+	if (m_sync == STACK_SYNC_ATOMIC)
+		m_base = (char*)allocator.Alloc(stackSize_bytes);
+}
 
-void* StackMemoryManager::Alloc(unsigned int size_bytes)
+void* StackMemoryManager::Alloc(size_t size_bytes, size_t align)
 {
+	if (m_sync == STACK_SYNC_ATOMIC)
+	{
+		assert((align & (align - 1)) == 0 && "Alignment must be a power of two");
+
+		// Reserve enough for any alignment so a single fetch-add is all it takes.
+		size_t offset = m_top.fetch_add(size_bytes + align - 1, std::memory_order_relaxed);
+		assert(offset + size_bytes + align - 1 <= m_size && "Stack allocator overflow");
+
+		return (char*)(((size_t)(m_base + offset) + align - 1) & ~(size_t)(align - 1));
+	}
+
 	std::lock_guard<std::mutex> lock(mtx);
-	return allocator.Alloc(size_bytes);
+	return allocator.Alloc(size_bytes, align);
+}
+
+void StackMemoryManager::AllocN(void** out, const size_t* sizes_bytes, unsigned count, size_t align)
+{
+	size_t total = 0;
+	for (unsigned i = 0; i < count; ++i)
+		total += (sizes_bytes[i] + align - 1) & ~(align - 1);
+
+	char* ptr = (char*)Alloc(total, align);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		out[i] = ptr;
+		ptr += (sizes_bytes[i] + align - 1) & ~(align - 1);
+	}
 }
 
 void StackMemoryManager::Clear()
 {
-	allocator.Clear();
-}
\ No newline at end of file
+	if (m_sync == STACK_SYNC_ATOMIC)
+		m_top.store(0);
+	else
+		allocator.Clear();
+}
+
+StackMemoryManager::Marker StackMemoryManager::GetMarker()
+{
+	if (m_sync == STACK_SYNC_ATOMIC)
+		return m_top.load();
+
+	std::lock_guard<std::mutex> lock(mtx);
+	return allocator.GetMarker();
+}
+
+void StackMemoryManager::FreeToMarker(Marker marker)
+{
+	if (m_sync == STACK_SYNC_ATOMIC)
+	{
+		assert(marker <= m_top.load() && "Marker is above the top of the stack");
+		m_top.store(marker);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mtx);
+	allocator.FreeToMarker(marker);
+}
+
+StackSync StackMemoryManager::GetSync() const
+{
+	return m_sync;
+}
+
+
+StackThreadBuffer::StackThreadBuffer(StackMemoryManager& stack, size_t chunkSize_bytes)
+	: m_stack(stack), m_chunkSize(chunkSize_bytes), m_ptr(nullptr), m_end(nullptr), m_waste(0)
+{}
+
+void* StackThreadBuffer::Alloc(size_t size_bytes, size_t align)
+{
+	char* ptr = (char*)(((size_t)m_ptr + align - 1) & ~(size_t)(align - 1));
+
+	if (m_ptr == nullptr || ptr + size_bytes > m_end)
+	{
+		if (size_bytes + align - 1 > m_chunkSize / 2)
+		{
+			// Too big to be worth a chunk, take it straight from the shared stack.
+			if (m_stack.GetSync() == STACK_SYNC_ATOMIC)
+				m_waste += align - 1;
+			return m_stack.Alloc(size_bytes, align);
+		}
+
+		// The tail of the current chunk is lost.
+		m_waste += m_end - m_ptr;
+
+		m_ptr = (char*)m_stack.Alloc(m_chunkSize);
+		m_end = m_ptr + m_chunkSize;
+		ptr = (char*)(((size_t)m_ptr + align - 1) & ~(size_t)(align - 1));
+	}
+
+	m_waste += ptr - m_ptr;
+	m_ptr = ptr + size_bytes;
+
+	return ptr;
+}
+
+size_t StackThreadBuffer::GetWaste() const
+{
+	return m_waste + (m_end - m_ptr);
+}
@@ -1,38 +1,131 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
+#include <cstddef>
+#include "BackingStore.h"
 
 class StackAllocator
 {
 public:
-	StackAllocator(unsigned int stackSize_bytes);
+	// Position in the stack that can be rolled back to with FreeToMarker.
+	typedef size_t Marker;
+
+	// The stack comes from store, or from BackingStore::Default() if it is nullptr.
+	StackAllocator(size_t stackSize_bytes, BackingStore* store = nullptr);
 	~StackAllocator();
 
-	void* Alloc(unsigned int size_bytes);
+	// align must be a power of two.
+	void* Alloc(size_t size_bytes, size_t align = 1);
 	void Clear();
 
-	unsigned int GetTotalSize() const;
-	unsigned int GetAllocatedSize() const;
+	Marker GetMarker() const;
+	// Releases everything allocated after the marker was taken.
+	void FreeToMarker(Marker marker);
+
+	size_t GetTotalSize() const;
+	size_t GetAllocatedSize() const;
 
 private:
 	void* m_mem;
 	void* m_ptr;
-	unsigned int m_stackSize_bytes;
+	size_t m_stackSize_bytes;
+	BackingStore* m_store;
+};
+
+enum StackSync
+{
+	STACK_SYNC_MUTEX,	// Every Alloc takes a lock around the stack.
+	STACK_SYNC_ATOMIC	// Alloc bumps the top with a single atomic fetch-add.
 };
 
 class StackMemoryManager
 {
 public:
-	StackMemoryManager(unsigned int stackSize_bytes);
+	typedef StackAllocator::Marker Marker;
+
+	StackMemoryManager(size_t stackSize_bytes, StackSync sync = STACK_SYNC_MUTEX, BackingStore* store = nullptr);
 
-	void* Alloc(unsigned int size_bytes);
+	// With STACK_SYNC_ATOMIC an aligned Alloc reserves align - 1 extra bytes.
+	void* Alloc(size_t size_bytes, size_t align = 1);
+	// Allocates count blocks with a single lock or fetch-add. Every block is aligned,
+	// sizes are rounded up to the alignment.
+	void AllocN(void** out, const size_t* sizes_bytes, unsigned count, size_t align = 1);
 	void Clear();
+
+	// Rolling back is only safe when no other thread has allocated since the marker was taken.
+	Marker GetMarker();
+	void FreeToMarker(Marker marker);
+
+	StackSync GetSync() const;
 private:
 	StackAllocator allocator;
 	std::mutex mtx;
+
+	// The atomic mode claims the whole stack from the allocator up front and bumps through it itself.
+	StackSync m_sync;
+	char* m_base;
+	size_t m_size;
+	std::atomic<size_t> m_top;
+};
+
+/*
+	Per-thread front end for a StackMemoryManager.
+
+	With a chunk size, the thread grabs chunks of that size from the shared stack
+	and bump allocates inside them without synchronization. Allocations that don't
+	fit in a chunk go to the shared stack directly. With a chunk size of 0 every
+	Alloc goes to the shared stack.
+
+	Tracks the bytes this thread took from the stack without handing them out:
+	alignment padding and the unused tails of chunks.
+	Owned and used by a single thread, and only valid until the stack is cleared.
+*/
+class StackThreadBuffer
+{
+public:
+	StackThreadBuffer(StackMemoryManager& stack, size_t chunkSize_bytes);
+
+	void* Alloc(size_t size_bytes, size_t align = 1);
+
+	// Includes the unused rest of the current chunk.
+	size_t GetWaste() const;
+
+private:
+	StackMemoryManager& m_stack;
+	size_t m_chunkSize;
+	char* m_ptr;
+	char* m_end;
+	size_t m_waste;
+};
+
+/*
+	Takes a marker on construction and frees back to it on destruction,
+	so temporaries allocated inside a scope are released when it ends.
+	Works with StackAllocator and StackMemoryManager.
+*/
+template <typename T>
+class StackScope
+{
+public:
+	StackScope(T& stack)
+		: m_stack(stack), m_marker(stack.GetMarker())
+	{}
+
+	~StackScope()
+	{
+		m_stack.FreeToMarker(m_marker);
+	}
+
+private:
+	StackScope(const StackScope&);
+	StackScope& operator=(const StackScope&);
+
+	T& m_stack;
+	typename T::Marker m_marker;
 };
 
 inline void* operator new(size_t nbytes, StackMemoryManager& manager)
 {
 	return manager.Alloc(nbytes);
-}
\ No newline at end of file
+}
@@ -0,0 +1,268 @@
+#include "TLSFAllocator.h"
+#include "BitScan.h"
+#include <cassert>
+
+size_t TLSFAllocator::SizeOf(const Block* block)
+{
+	return block->m_size & ~(BLOCK_FREE | BLOCK_PREV_FREE);
+}
+
+TLSFAllocator::Block* TLSFAllocator::FromPtr(const void* ptr)
+{
+	return (Block*)((const char*)ptr - BLOCK_START_OFFSET);
+}
+
+char* TLSFAllocator::ToPtr(Block* block)
+{
+	return (char*)block + BLOCK_START_OFFSET;
+}
+
+TLSFAllocator::Block* TLSFAllocator::Next(Block* block)
+{
+	return (Block*)(ToPtr(block) + SizeOf(block) - BLOCK_OVERHEAD);
+}
+
+TLSFAllocator::Block* TLSFAllocator::LinkNext(Block* block)
+{
+	Block* next = Next(block);
+	next->m_prevPhysical = block;
+	return next;
+}
+
+void TLSFAllocator::MarkFree(Block* block)
+{
+	Block* next = LinkNext(block);
+	next->m_size |= BLOCK_PREV_FREE;
+	block->m_size |= BLOCK_FREE;
+}
+
+void TLSFAllocator::MarkUsed(Block* block)
+{
+	Block* next = Next(block);
+	next->m_size &= ~BLOCK_PREV_FREE;
+	block->m_size &= ~BLOCK_FREE;
+}
+
+void TLSFAllocator::MappingInsert(size_t size, unsigned& fl, unsigned& sl)
+{
+	if (size < SMALL_BLOCK_SIZE)
+	{
+		fl = 0;
+		sl = (unsigned)(size / (SMALL_BLOCK_SIZE / SL_COUNT));
+	}
+	else
+	{
+		unsigned high = HighestSetBit64(size);
+		sl = (unsigned)(size >> (high - SL_COUNT_LOG2)) ^ SL_COUNT;
+		fl = high - (FL_SHIFT - 1);
+	}
+}
+
+void TLSFAllocator::MappingSearch(size_t size, unsigned& fl, unsigned& sl)
+{
+	if (size >= SMALL_BLOCK_SIZE)
+		size += ((size_t)1 << (HighestSetBit64(size) - SL_COUNT_LOG2)) - 1;
+
+	MappingInsert(size, fl, sl);
+}
+
+TLSFAllocator::TLSFAllocator(void* mem, size_t size_bytes)
+	: m_flBitmap(0), m_totalSize(0), m_usedSize(0)
+{
+	m_null.m_nextFree = &m_null;
+	m_null.m_prevFree = &m_null;
+
+	for (unsigned i = 0; i < FL_COUNT; ++i)
+	{
+		m_slBitmap[i] = 0;
+		for (unsigned j = 0; j < SL_COUNT; ++j)
+			m_blocks[i][j] = &m_null;
+	}
+
+	// Room for the first block's size word and the zero-size sentinel at the end.
+	char* start = (char*)(((size_t)mem + ALIGN - 1) & ~(ALIGN - 1));
+	size_t available = size_bytes - (start - (char*)mem);
+	size_t poolSize = (available - 2 * BLOCK_OVERHEAD) & ~(ALIGN - 1);
+
+	assert(available > 2 * BLOCK_OVERHEAD && poolSize >= BLOCK_SIZE_MIN && "Region too small");
+	assert(poolSize < BLOCK_SIZE_MAX && "Region too large");
+
+	// The first block's m_prevPhysical would sit in front of the region, it is never read
+	// because the block is never marked as having a free predecessor.
+	Block* block = (Block*)(start - sizeof(Block*));
+	block->m_size = poolSize;
+	block->m_size |= BLOCK_FREE;
+	Insert(block);
+
+	Block* sentinel = LinkNext(block);
+	sentinel->m_size = BLOCK_PREV_FREE;
+
+	m_totalSize = poolSize;
+}
+
+TLSFAllocator::Block* TLSFAllocator::FindSuitable(unsigned& fl, unsigned& sl)
+{
+	// A list at or above sl in this first level, else the first non-empty level above it.
+	unsigned slMap = m_slBitmap[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		unsigned flMap = fl + 1 < 32 ? m_flBitmap & (~0u << (fl + 1)) : 0;
+		if (flMap == 0)
+			return nullptr;
+
+		fl = CountTrailingZeros(flMap);
+		slMap = m_slBitmap[fl];
+	}
+
+	sl = CountTrailingZeros(slMap);
+	return m_blocks[fl][sl];
+}
+
+void TLSFAllocator::RemoveFree(Block* block, unsigned fl, unsigned sl)
+{
+	Block* prev = block->m_prevFree;
+	Block* next = block->m_nextFree;
+	next->m_prevFree = prev;
+	prev->m_nextFree = next;
+
+	if (m_blocks[fl][sl] == block)
+	{
+		m_blocks[fl][sl] = next;
+
+		if (next == &m_null)
+		{
+			m_slBitmap[fl] &= ~(1u << sl);
+			if (m_slBitmap[fl] == 0)
+				m_flBitmap &= ~(1u << fl);
+		}
+	}
+}
+
+void TLSFAllocator::InsertFree(Block* block, unsigned fl, unsigned sl)
+{
+	Block* current = m_blocks[fl][sl];
+	block->m_nextFree = current;
+	block->m_prevFree = &m_null;
+	current->m_prevFree = block;
+
+	m_blocks[fl][sl] = block;
+	m_flBitmap |= 1u << fl;
+	m_slBitmap[fl] |= 1u << sl;
+}
+
+void TLSFAllocator::Remove(Block* block)
+{
+	unsigned fl, sl;
+	MappingInsert(SizeOf(block), fl, sl);
+	RemoveFree(block, fl, sl);
+}
+
+void TLSFAllocator::Insert(Block* block)
+{
+	unsigned fl, sl;
+	MappingInsert(SizeOf(block), fl, sl);
+	InsertFree(block, fl, sl);
+}
+
+TLSFAllocator::Block* TLSFAllocator::Split(Block* block, size_t size)
+{
+	Block* remaining = (Block*)(ToPtr(block) + size - BLOCK_OVERHEAD);
+	remaining->m_size = SizeOf(block) - (size + BLOCK_OVERHEAD);
+
+	block->m_size = size | (block->m_size & (BLOCK_FREE | BLOCK_PREV_FREE));
+
+	MarkFree(remaining);
+	return remaining;
+}
+
+TLSFAllocator::Block* TLSFAllocator::Absorb(Block* prev, Block* block)
+{
+	prev->m_size += SizeOf(block) + BLOCK_OVERHEAD;
+	LinkNext(prev);
+	return prev;
+}
+
+TLSFAllocator::Block* TLSFAllocator::MergePrev(Block* block)
+{
+	if (block->m_size & BLOCK_PREV_FREE)
+	{
+		Block* prev = block->m_prevPhysical;
+		Remove(prev);
+		block = Absorb(prev, block);
+	}
+	return block;
+}
+
+TLSFAllocator::Block* TLSFAllocator::MergeNext(Block* block)
+{
+	Block* next = Next(block);
+	if (next->m_size & BLOCK_FREE)
+	{
+		Remove(next);
+		block = Absorb(block, next);
+	}
+	return block;
+}
+
+void* TLSFAllocator::Alloc(size_t size_bytes)
+{
+	if (size_bytes == 0 || size_bytes >= BLOCK_SIZE_MAX)
+		return nullptr;
+
+	size_t size = (size_bytes + ALIGN - 1) & ~(ALIGN - 1);
+	if (size < BLOCK_SIZE_MIN)
+		size = BLOCK_SIZE_MIN;
+
+	unsigned fl, sl;
+	MappingSearch(size, fl, sl);
+	if (fl >= FL_COUNT)
+		return nullptr;
+
+	Block* block = FindSuitable(fl, sl);
+	if (block == nullptr)
+		return nullptr;
+
+	RemoveFree(block, fl, sl);
+
+	// Give the tail back if it is big enough to be a block of its own.
+	if (SizeOf(block) >= sizeof(Block) + size)
+	{
+		Block* remaining = Split(block, size);
+		Insert(remaining);
+	}
+
+	MarkUsed(block);
+	m_usedSize += SizeOf(block);
+	return ToPtr(block);
+}
+
+void TLSFAllocator::Free(void* ptr)
+{
+	if (ptr == nullptr)
+		return;
+
+	Block* block = FromPtr(ptr);
+	assert(!(block->m_size & BLOCK_FREE) && "Block freed twice");
+
+	m_usedSize -= SizeOf(block);
+
+	MarkFree(block);
+	block = MergePrev(block);
+	block = MergeNext(block);
+	Insert(block);
+}
+
+size_t TLSFAllocator::GetBlockSize(const void* ptr) const
+{
+	return SizeOf(FromPtr(ptr));
+}
+
+size_t TLSFAllocator::GetUsedSize() const
+{
+	return m_usedSize;
+}
+
+size_t TLSFAllocator::GetTotalSize() const
+{
+	return m_totalSize;
+}
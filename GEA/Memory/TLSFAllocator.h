@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+	Two-Level Segregated Fit allocator for variable-size blocks in a caller-provided region.
+
+	Free blocks are kept in lists indexed by a power-of-two first level, split linearly into
+	SL_COUNT second level ranges. Two bitmaps record which lists are non-empty, so finding a
+	block that fits is a pair of bit scans and Alloc and Free run in constant time whatever
+	the heap looks like. Freed blocks merge with free neighbours straight away.
+
+	Not thread safe. Blocks are 8 byte aligned.
+*/
+class TLSFAllocator
+{
+public:
+	// The region must outlive the allocator and is not freed by it.
+	TLSFAllocator(void* mem, size_t size_bytes);
+
+	// Returns nullptr when no free block is large enough.
+	void* Alloc(size_t size_bytes);
+	void Free(void* ptr);
+
+	// Usable size of an allocated block, at least what was asked for.
+	size_t GetBlockSize(const void* ptr) const;
+	size_t GetUsedSize() const;
+	size_t GetTotalSize() const;
+
+private:
+	static const unsigned ALIGN_LOG2 = 3;
+	static const size_t ALIGN = (size_t)1 << ALIGN_LOG2;
+
+	static const unsigned SL_COUNT_LOG2 = 5;
+	static const unsigned SL_COUNT = 1u << SL_COUNT_LOG2;
+
+	// Sizes below SMALL_BLOCK_SIZE all go in first level 0, split linearly.
+	static const unsigned FL_SHIFT = SL_COUNT_LOG2 + ALIGN_LOG2;
+	static const unsigned FL_MAX = sizeof(size_t) == 8 ? 32 : 30;
+	static const unsigned FL_COUNT = FL_MAX - FL_SHIFT + 1;
+	static const size_t SMALL_BLOCK_SIZE = (size_t)1 << FL_SHIFT;
+
+	struct Block
+	{
+		// Only valid while the previous physical block is free. It is the last word of that block.
+		Block* m_prevPhysical;
+		// Payload size, the low bits hold BLOCK_FREE and BLOCK_PREV_FREE.
+		size_t m_size;
+		// Only valid while this block is free, they overlap the payload.
+		Block* m_nextFree;
+		Block* m_prevFree;
+	};
+
+	static const size_t BLOCK_FREE = 1;
+	static const size_t BLOCK_PREV_FREE = 2;
+
+	// A used block only pays for m_size, m_prevPhysical lives in the previous block.
+	static const size_t BLOCK_OVERHEAD = sizeof(size_t);
+	static const size_t BLOCK_START_OFFSET = sizeof(Block*) + sizeof(size_t);
+	static const size_t BLOCK_SIZE_MIN = sizeof(Block) - sizeof(Block*);
+	static const size_t BLOCK_SIZE_MAX = (size_t)1 << FL_MAX;
+
+	static size_t SizeOf(const Block* block);
+	static Block* FromPtr(const void* ptr);
+	static char* ToPtr(Block* block);
+	static Block* Next(Block* block);
+	// Next physical block, with its back link pointed at block.
+	static Block* LinkNext(Block* block);
+	static void MarkFree(Block* block);
+	static void MarkUsed(Block* block);
+
+	static void MappingInsert(size_t size, unsigned& fl, unsigned& sl);
+	// Like MappingInsert, but rounds up so any block in the resulting list fits size.
+	static void MappingSearch(size_t size, unsigned& fl, unsigned& sl);
+
+	Block* FindSuitable(unsigned& fl, unsigned& sl);
+	void RemoveFree(Block* block, unsigned fl, unsigned sl);
+	void InsertFree(Block* block, unsigned fl, unsigned sl);
+	void Remove(Block* block);
+	void Insert(Block* block);
+
+	// Splits off everything past size into a new free block and returns it.
+	Block* Split(Block* block, size_t size);
+	Block* Absorb(Block* prev, Block* block);
+	Block* MergePrev(Block* block);
+	Block* MergeNext(Block* block);
+
+	// Terminates every free list, so unlinking never has to check for nullptr.
+	Block m_null;
+
+	unsigned m_flBitmap;
+	unsigned m_slBitmap[FL_COUNT];
+	Block* m_blocks[FL_COUNT][SL_COUNT];
+
+	size_t m_totalSize;
+	size_t m_usedSize;
+};
@@ -0,0 +1,99 @@
+#include "VirtualArena.h"
+#include "VirtualMemory.h"
+#include <cassert>
+
+VirtualArena::VirtualArena(size_t reserveSize_bytes, size_t commitGranularity_bytes, bool decommit)
+	: m_mem(nullptr), m_ptr(nullptr), m_committed(nullptr), m_reserveSize_bytes(0), m_granularity(0), m_decommit(decommit)
+{
+	size_t page = VirtualMemory::GetPageSize();
+	m_granularity = (commitGranularity_bytes + page - 1) / page * page;
+	m_reserveSize_bytes = (reserveSize_bytes + m_granularity - 1) / m_granularity * m_granularity;
+
+	m_mem = (char*)VirtualMemory::Reserve(m_reserveSize_bytes);
+	assert(m_mem != nullptr && "Failed to reserve address space");
+
+	m_ptr = m_mem;
+	m_committed = m_mem;
+}
+
+VirtualArena::~VirtualArena()
+{
+	if (m_mem != nullptr)
+	{
+		VirtualMemory::Release(m_mem, m_reserveSize_bytes);
+		m_mem = nullptr;
+	}
+}
+
+void* VirtualArena::Alloc(size_t size_bytes, size_t align)
+{
+	assert((align & (align - 1)) == 0 && "Alignment must be a power of two");
+
+	char* ptr = (char*)(((size_t)m_ptr + align - 1) & ~(size_t)(align - 1));
+	// Alignment can move ptr past the end of the reservation, compare pointers first.
+	char* reserveEnd = m_mem + m_reserveSize_bytes;
+	if (ptr > reserveEnd || size_bytes > (size_t)(reserveEnd - ptr))
+		return nullptr;
+
+	char* end = ptr + size_bytes;
+	if (end > m_committed)
+	{
+		// Commit whole granules up to the new top.
+		size_t size = (end - m_committed + m_granularity - 1) / m_granularity * m_granularity;
+		if (!VirtualMemory::Commit(m_committed, size))
+			return nullptr;
+		m_committed += size;
+	}
+
+	m_ptr = end;
+	return ptr;
+}
+
+void VirtualArena::Clear()
+{
+	m_ptr = m_mem;
+
+	if (m_decommit)
+		Shrink();
+}
+
+VirtualArena::Marker VirtualArena::GetMarker() const
+{
+	return m_ptr - m_mem;
+}
+
+void VirtualArena::FreeToMarker(Marker marker)
+{
+	assert(marker <= GetMarker() && "Marker is above the top of the stack");
+
+	m_ptr = m_mem + marker;
+
+	if (m_decommit)
+		Shrink();
+}
+
+// Decommits the granules that lie entirely above the top.
+void VirtualArena::Shrink()
+{
+	char* keep = m_mem + (m_ptr - m_mem + m_granularity - 1) / m_granularity * m_granularity;
+	if (keep < m_committed)
+	{
+		VirtualMemory::Decommit(keep, m_committed - keep);
+		m_committed = keep;
+	}
+}
+
+size_t VirtualArena::GetTotalSize() const
+{
+	return m_reserveSize_bytes;
+}
+
+size_t VirtualArena::GetAllocatedSize() const
+{
+	return m_ptr - m_mem;
+}
+
+size_t VirtualArena::GetCommittedSize() const
+{
+	return m_committed - m_mem;
+}
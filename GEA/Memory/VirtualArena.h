@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+	Stack allocator over a large reserved address range.
+
+	Only address space is reserved up front. Pages are committed in steps of the commit
+	granularity as the top of the stack moves past them, so a huge arena only costs the
+	memory it has actually touched. With decommit enabled, Clear and FreeToMarker hand
+	the pages above the new top back to the OS.
+*/
+class VirtualArena
+{
+public:
+	typedef size_t Marker;
+
+	// commitGranularity_bytes is rounded up to whole pages.
+	VirtualArena(size_t reserveSize_bytes, size_t commitGranularity_bytes = 64 * 1024, bool decommit = false);
+	~VirtualArena();
+
+	// align must be a power of two. Returns nullptr once the reserved range is used up.
+	void* Alloc(size_t size_bytes, size_t align = 1);
+	void Clear();
+
+	Marker GetMarker() const;
+	void FreeToMarker(Marker marker);
+
+	size_t GetTotalSize() const;
+	size_t GetAllocatedSize() const;
+	size_t GetCommittedSize() const;
+
+private:
+	VirtualArena(const VirtualArena&);
+	VirtualArena& operator=(const VirtualArena&);
+
+	void Shrink();
+
+	char* m_mem;
+	char* m_ptr;
+	char* m_committed;
+	size_t m_reserveSize_bytes;
+	size_t m_granularity;
+	bool m_decommit;
+};
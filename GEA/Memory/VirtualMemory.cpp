@@ -0,0 +1,81 @@
+#include "VirtualMemory.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace VirtualMemory
+{
+	size_t GetPageSize()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	void* Reserve(size_t size)
+	{
+#ifdef _WIN32
+		return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+		void* ptr = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		return ptr == MAP_FAILED ? nullptr : ptr;
+#endif
+	}
+
+	bool Commit(void* ptr, size_t size)
+	{
+#ifdef _WIN32
+		return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+		return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+	}
+
+	void Prefault(void* ptr, size_t size)
+	{
+		size_t pageSize = GetPageSize();
+		for (size_t offset = 0; offset < size; offset += pageSize)
+			((volatile char*)ptr)[offset] = 0;
+	}
+
+	void Decommit(void* ptr, size_t size)
+	{
+#ifdef _WIN32
+		VirtualFree(ptr, size, MEM_DECOMMIT);
+#else
+		madvise(ptr, size, MADV_DONTNEED);
+		mprotect(ptr, size, PROT_NONE);
+#endif
+	}
+
+	void Reset(void* ptr, size_t size)
+	{
+#ifdef _WIN32
+		VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+#else
+#ifdef MADV_FREE
+		// Kernels before 4.5 reject MADV_FREE.
+		if (madvise(ptr, size, MADV_FREE) == 0)
+			return;
+#endif
+		madvise(ptr, size, MADV_DONTNEED);
+#endif
+	}
+
+	void Release(void* ptr, size_t size)
+	{
+#ifdef _WIN32
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, size);
+#endif
+	}
+}
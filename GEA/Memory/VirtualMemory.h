@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+	Thin wrapper over the OS virtual memory calls.
+	Addresses and sizes passed to Commit/Decommit must be page aligned.
+*/
+namespace VirtualMemory
+{
+	size_t GetPageSize();
+
+	// Reserves address space without backing it with memory. Returns nullptr on failure.
+	void* Reserve(size_t size);
+	// Makes reserved pages readable and writable.
+	bool Commit(void* ptr, size_t size);
+	// Touches every page of a writable range so it is backed before first use.
+	void Prefault(void* ptr, size_t size);
+	// Hands the pages back to the OS but keeps the address range reserved.
+	void Decommit(void* ptr, size_t size);
+	// Tells the OS the contents are no longer needed. The pages stay usable and are only
+	// reclaimed under memory pressure, reading them afterwards gives old data or zeros.
+	void Reset(void* ptr, size_t size);
+	// Releases a whole range from Reserve.
+	void Release(void* ptr, size_t size);
+}
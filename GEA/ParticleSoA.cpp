@@ -0,0 +1,119 @@
+#include "ParticleSoA.h"
+#include <cassert>
+#include <immintrin.h>
+#include "Memory/BitScan.h"
+
+// Lifetimes are processed in whole vectors, so the array is padded to a multiple of the widest one.
+static const unsigned LIFETIME_LANES = 8;
+
+#if defined(__AVX2__)
+static const unsigned LIFETIME_VECTOR_WIDTH = 8;
+
+// Decrements eight lifetimes and returns a bit mask of the lanes that dropped below one.
+static inline unsigned DecrementLifetimes(int* lifetimes)
+{
+	const __m256i one = _mm256_set1_epi32(1);
+
+	__m256i v = _mm256_load_si256((const __m256i*)lifetimes);
+	v = _mm256_sub_epi32(v, one);
+	_mm256_store_si256((__m256i*)lifetimes, v);
+
+	return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(one, v)));
+}
+#else
+static const unsigned LIFETIME_VECTOR_WIDTH = 4;
+
+// Decrements four lifetimes and returns a bit mask of the lanes that dropped below one.
+static inline unsigned DecrementLifetimes(int* lifetimes)
+{
+	const __m128i one = _mm_set1_epi32(1);
+
+	__m128i v = _mm_load_si128((const __m128i*)lifetimes);
+	v = _mm_sub_epi32(v, one);
+	_mm_store_si128((__m128i*)lifetimes, v);
+
+	return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, one)));
+}
+#endif
+
+ParticleSoA::ParticleSoA(unsigned capacity, unsigned payloadSize)
+	: m_lifetimes(nullptr), m_payloads(nullptr), m_count(0), m_capacity(capacity), m_payloadPool(payloadSize, capacity)
+{
+	unsigned padded = (capacity + LIFETIME_LANES - 1) / LIFETIME_LANES * LIFETIME_LANES;
+
+	m_lifetimes = (int*)_mm_malloc(sizeof(int) * padded, 32);
+	m_payloads = new void*[capacity];
+
+	for (unsigned i = 0; i < padded; ++i)
+		m_lifetimes[i] = 0;
+}
+
+ParticleSoA::~ParticleSoA()
+{
+	_mm_free(m_lifetimes);
+	delete [] m_payloads;
+}
+
+bool ParticleSoA::Spawn(int lifetime)
+{
+	if (m_count == m_capacity)
+		return false;
+
+	m_lifetimes[m_count] = lifetime;
+	m_payloads[m_count] = m_payloadPool.Alloc();
+	m_count++;
+	return true;
+}
+
+unsigned ParticleSoA::UpdateLifetimes(unsigned* dead)
+{
+	unsigned deadCount = 0;
+
+	for (unsigned i = 0; i < m_count; i += LIFETIME_VECTOR_WIDTH)
+	{
+		unsigned mask = DecrementLifetimes(&m_lifetimes[i]);
+
+		while (mask != 0)
+		{
+			unsigned index = i + CountTrailingZeros(mask);
+			mask &= mask - 1;
+
+			// The last vector may reach past the live particles.
+			if (index < m_count)
+				dead[deadCount++] = index;
+		}
+	}
+
+	return deadCount;
+}
+
+void ParticleSoA::Compact(const unsigned* dead, unsigned deadCount)
+{
+	// Walk from the back so every particle moved in from the end is still alive.
+	for (unsigned k = deadCount; k-- > 0; )
+	{
+		unsigned index = dead[k];
+		assert(index < m_count && "Dead index is not live");
+
+		m_payloadPool.Free(m_payloads[index]);
+
+		unsigned last = --m_count;
+		m_lifetimes[index] = m_lifetimes[last];
+		m_payloads[index] = m_payloads[last];
+	}
+}
+
+void* ParticleSoA::GetPayload(unsigned index) const
+{
+	return m_payloads[index];
+}
+
+unsigned ParticleSoA::GetCount() const
+{
+	return m_count;
+}
+
+unsigned ParticleSoA::GetCapacity() const
+{
+	return m_capacity;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Memory/PoolAllocator.h"
+
+/*
+	Structure-of-arrays particle storage.
+
+	The hot lifetime field of every live particle sits packed in its own aligned array,
+	while the cold payload lives in a separate pool and is only referenced. A frame update
+	decrements all lifetimes with SIMD (AVX2 when compiled for it, SSE2 otherwise) and
+	collects the indices of dead particles, which Compact then removes by swap-and-pop.
+*/
+class ParticleSoA
+{
+public:
+	ParticleSoA(unsigned capacity, unsigned payloadSize);
+	~ParticleSoA();
+
+	// Returns false when the container is full.
+	bool Spawn(int lifetime);
+
+	// Decrements every lifetime and writes the indices of the particles that died,
+	// in ascending order, to dead. Returns the number of dead particles.
+	unsigned UpdateLifetimes(unsigned* dead);
+
+	// Removes the particles at the given ascending indices and frees their payloads.
+	void Compact(const unsigned* dead, unsigned deadCount);
+
+	void* GetPayload(unsigned index) const;
+	unsigned GetCount() const;
+	unsigned GetCapacity() const;
+
+private:
+	ParticleSoA(const ParticleSoA&);
+	ParticleSoA& operator=(const ParticleSoA&);
+
+	int* m_lifetimes;
+	void** m_payloads;
+	unsigned m_count;
+	unsigned m_capacity;
+
+	PoolAllocator m_payloadPool;
+};
@@ -0,0 +1,163 @@
+#include "PerfCounters.h"
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+	struct PerfEvent
+	{
+		unsigned int type;
+		unsigned long long config;
+	};
+
+	const PerfEvent PERF_EVENTS[PERF_COUNTER_COUNT] =
+	{
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	};
+
+	int OpenEvent(const PerfEvent& event, int leader, bool excludeKernel)
+	{
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = event.type;
+		attr.config = event.config;
+		attr.disabled = leader == -1 ? 1 : 0;
+		attr.exclude_kernel = excludeKernel ? 1 : 0;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// This thread, any CPU.
+		return (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+	}
+#endif
+
+	const char* PERF_COUNTER_NAMES[PERF_COUNTER_COUNT] =
+	{
+		"Cycles",
+		"Instructions",
+		"L1D Misses",
+		"LLC Misses",
+		"dTLB Misses",
+		"Page Faults",
+	};
+}
+
+PerfCounters::PerfCounters()
+	: m_leader(-1), m_openCount(0)
+{
+	memset(&m_frame, 0, sizeof(m_frame));
+	memset(&m_total, 0, sizeof(m_total));
+
+	for (unsigned i = 0; i < PERF_COUNTER_COUNT; ++i)
+		m_fds[i] = -1;
+
+#ifdef __linux__
+	for (unsigned i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		// Restricted perf_event_paranoid settings only allow counting user space.
+		int fd = OpenEvent(PERF_EVENTS[i], m_leader, false);
+		if (fd == -1)
+			fd = OpenEvent(PERF_EVENTS[i], m_leader, true);
+		if (fd == -1)
+			continue;
+
+		if (m_leader == -1)
+			m_leader = fd;
+
+		m_fds[i] = fd;
+		m_order[m_openCount++] = (PerfCounter)i;
+	}
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+	for (unsigned i = 0; i < PERF_COUNTER_COUNT; ++i)
+	{
+		if (m_fds[i] != -1)
+			close(m_fds[i]);
+	}
+#endif
+}
+
+void PerfCounters::Start()
+{
+#ifdef __linux__
+	if (m_leader == -1)
+		return;
+
+	ioctl(m_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+void PerfCounters::Stop()
+{
+#ifdef __linux__
+	if (m_leader == -1)
+		return;
+
+	ioctl(m_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	// Group read: count, time enabled, time running, then one value per counter.
+	unsigned long long data[3 + PERF_COUNTER_COUNT];
+	memset(&m_frame, 0, sizeof(m_frame));
+	if (read(m_leader, data, sizeof(data)) < (ssize_t)((3 + m_openCount) * sizeof(unsigned long long)))
+		return;
+
+	// Scale up if the group shared the PMU with other events and was only counted part of the time.
+	unsigned long long enabled = data[1];
+	unsigned long long running = data[2];
+	if (running == 0)
+		return;
+
+	for (unsigned i = 0; i < m_openCount; ++i)
+	{
+		unsigned long long value = data[3 + i];
+		if (running < enabled)
+			value = (unsigned long long)((double)value * enabled / running);
+
+		m_frame.values[m_order[i]] = value;
+		m_total.values[m_order[i]] += value;
+	}
+#endif
+}
+
+bool PerfCounters::IsAvailable(PerfCounter counter) const
+{
+	return m_fds[counter] != -1;
+}
+
+bool PerfCounters::IsAnyAvailable() const
+{
+	return m_leader != -1;
+}
+
+const PerfSample& PerfCounters::GetFrame() const
+{
+	return m_frame;
+}
+
+const PerfSample& PerfCounters::GetTotal() const
+{
+	return m_total;
+}
+
+const char* PerfCounters::GetName(PerfCounter counter)
+{
+	return PERF_COUNTER_NAMES[counter];
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+enum PerfCounter
+{
+	PERF_COUNTER_CYCLES,
+	PERF_COUNTER_INSTRUCTIONS,
+	PERF_COUNTER_L1D_MISSES,
+	PERF_COUNTER_LLC_MISSES,
+	PERF_COUNTER_DTLB_MISSES,
+	PERF_COUNTER_PAGE_FAULTS,
+	PERF_COUNTER_COUNT
+};
+
+struct PerfSample
+{
+	unsigned long long values[PERF_COUNTER_COUNT];
+};
+
+/*
+	CPU event counters of the calling thread, read with perf_event_open on Linux.
+
+	The counters are opened as one group so they cover exactly the same instructions.
+	Events the system refuses, like hardware events in a VM without a PMU or everything
+	on other platforms, are left out and read as zero. Check IsAvailable before using a
+	value. Owned and used by a single thread.
+*/
+class PerfCounters
+{
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	// Counts between Start and Stop make up the current frame and are added to the total.
+	void Start();
+	void Stop();
+
+	bool IsAvailable(PerfCounter counter) const;
+	bool IsAnyAvailable() const;
+
+	const PerfSample& GetFrame() const;
+	const PerfSample& GetTotal() const;
+
+	static const char* GetName(PerfCounter counter);
+
+private:
+	PerfCounters(const PerfCounters&);
+	PerfCounters& operator=(const PerfCounters&);
+
+	// File descriptor per counter, -1 if unavailable. The first open one leads the group.
+	int m_fds[PERF_COUNTER_COUNT];
+	int m_leader;
+
+	// Counters in the order the group read returns them.
+	PerfCounter m_order[PERF_COUNTER_COUNT];
+	unsigned m_openCount;
+
+	PerfSample m_frame;
+	PerfSample m_total;
+};
@@ -0,0 +1,49 @@
+#include "ProcessStats.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <cstdio>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+namespace ProcessStats
+{
+	size_t GetResidentMemory()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.WorkingSetSize;
+#else
+		FILE* file = fopen("/proc/self/statm", "r");
+		if (file == nullptr)
+			return 0;
+
+		unsigned long size = 0, resident = 0;
+		int read = fscanf(file, "%lu %lu", &size, &resident);
+		fclose(file);
+
+		return read == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#endif
+	}
+
+	size_t GetPageFaultCount()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.PageFaultCount;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+		return usage.ru_minflt + usage.ru_majflt;
+#endif
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ProcessStats
+{
+	// Returns the resident set (working set) size of the process in bytes.
+	size_t GetResidentMemory();
+
+	// Returns the number of page faults the process has taken so far.
+	size_t GetPageFaultCount();
+}
@@ -0,0 +1,195 @@
+#include "Profiler.h"
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+	struct ProfileEvent
+	{
+		const char* name;
+		unsigned long long begin;
+		unsigned long long end;
+	};
+
+	// Single producer, single consumer ring. The owning thread advances m_head, the
+	// flushing thread advances m_tail, on separate cache lines.
+	struct ProfileRing
+	{
+		ProfileRing(unsigned int threadId)
+			: m_head(0), m_tail(0), m_threadId(threadId)
+		{
+		}
+
+		ProfileEvent m_events[Profiler::RING_CAPACITY];
+		std::atomic<unsigned int> m_head;
+		char m_padding[64];
+		std::atomic<unsigned int> m_tail;
+
+		unsigned int m_threadId;
+		std::string m_threadName;
+	};
+
+	struct TraceEvent
+	{
+		const char* name;
+		unsigned long long begin;
+		unsigned long long end;
+		unsigned int threadId;
+	};
+
+	// Rings are never freed, a thread may exit before its events are flushed.
+	std::mutex s_mutex;
+	std::vector<ProfileRing*> s_rings;
+	std::vector<TraceEvent> s_events;
+
+	PROFILER_THREAD_LOCAL ProfileRing* t_ring = nullptr;
+
+	ProfileRing* GetRing()
+	{
+		if (t_ring == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(s_mutex);
+			t_ring = new ProfileRing((unsigned int)s_rings.size());
+			s_rings.push_back(t_ring);
+		}
+		return t_ring;
+	}
+
+	// Caller holds s_mutex.
+	void FlushRings()
+	{
+		for (size_t i = 0; i < s_rings.size(); ++i)
+		{
+			ProfileRing* ring = s_rings[i];
+			unsigned int tail = ring->m_tail.load(std::memory_order_relaxed);
+			unsigned int head = ring->m_head.load(std::memory_order_acquire);
+
+			for (; tail != head; ++tail)
+			{
+				const ProfileEvent& event = ring->m_events[tail % Profiler::RING_CAPACITY];
+				TraceEvent trace = { event.name, event.begin, event.end, ring->m_threadId };
+				s_events.push_back(trace);
+			}
+
+			ring->m_tail.store(tail, std::memory_order_release);
+		}
+	}
+
+	void WriteString(std::ofstream& file, const char* text)
+	{
+		file << '"';
+		for (; *text != '\0'; ++text)
+		{
+			if (*text == '"' || *text == '\\')
+				file << '\\';
+			file << *text;
+		}
+		file << '"';
+	}
+}
+
+namespace Profiler
+{
+	void Record(const char* name, unsigned long long begin_ticks, unsigned long long end_ticks)
+	{
+		ProfileRing* ring = GetRing();
+		unsigned int head = ring->m_head.load(std::memory_order_relaxed);
+
+		// Full, empty the rings here rather than lose the event.
+		if (head - ring->m_tail.load(std::memory_order_acquire) == RING_CAPACITY)
+			Flush();
+
+		ProfileEvent& event = ring->m_events[head % RING_CAPACITY];
+		event.name = name;
+		event.begin = begin_ticks;
+		event.end = end_ticks;
+
+		ring->m_head.store(head + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(const char* name, int index)
+	{
+		ProfileRing* ring = GetRing();
+
+		std::stringstream ss;
+		ss << name;
+		if (index >= 0)
+			ss << " " << index;
+
+		std::lock_guard<std::mutex> lock(s_mutex);
+		ring->m_threadName = ss.str();
+	}
+
+	void Flush()
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		FlushRings();
+	}
+
+	bool WriteChromeTrace(const char* path)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		FlushRings();
+
+		std::ofstream file(path, std::ios_base::trunc | std::ios_base::out);
+		if (!file)
+			return false;
+
+		// Timestamps and durations are in microseconds, from the first recorded event.
+		unsigned long long origin = (unsigned long long)-1;
+		for (size_t i = 0; i < s_events.size(); ++i)
+		{
+			if (s_events[i].begin < origin)
+				origin = s_events[i].begin;
+		}
+
+		double ticksPerMicrosecond = Timer::GetFrequency(TIMER_SOURCE_TSC) / 1000000.0;
+		file.setf(std::ios_base::fixed);
+		file.precision(3);
+
+		file << "{\"traceEvents\":[\n";
+		bool first = true;
+
+		for (size_t i = 0; i < s_rings.size(); ++i)
+		{
+			if (s_rings[i]->m_threadName.empty())
+				continue;
+
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << s_rings[i]->m_threadId << ",\"args\":{\"name\":";
+			WriteString(file, s_rings[i]->m_threadName.c_str());
+			file << "}}";
+			first = false;
+		}
+
+		for (size_t i = 0; i < s_events.size(); ++i)
+		{
+			const TraceEvent& event = s_events[i];
+			double begin = (double)(event.begin - origin) / ticksPerMicrosecond;
+			double duration = (double)(event.end - event.begin) / ticksPerMicrosecond;
+
+			file << (first ? "" : ",\n") << "{\"name\":";
+			WriteString(file, event.name);
+			file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.threadId << ",\"ts\":" << begin << ",\"dur\":" << duration << "}";
+			first = false;
+		}
+
+		file << "\n]}\n";
+		return file.good();
+	}
+
+	size_t GetEventCount()
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		return s_events.size();
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include "Timer.h"
+
+/*
+	Scoped profiler zones exported as a Chrome trace (chrome://tracing or Perfetto).
+
+	Zones are only compiled in when GEA_PROFILE is defined, otherwise every macro expands
+	to nothing. A zone records its begin and end time into a ring buffer owned by the
+	calling thread, without locking. Flush moves the events of all threads into the
+	trace and may be called from any thread. Tests call it between frames, a thread
+	that fills its ring before that flushes on its own and the lock lands in its zone.
+
+	Zone names must outlive the trace, use string literals.
+*/
+#ifdef GEA_PROFILE
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing scope.
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+// Names the calling thread in the trace, optionally followed by a number.
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name, -1)
+#define PROFILE_THREAD_INDEX(name, index) Profiler::SetThreadName(name, (int)(index))
+#define PROFILE_FLUSH() Profiler::Flush()
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_THREAD_INDEX(name, index) ((void)0)
+#define PROFILE_FLUSH() ((void)0)
+
+#endif
+
+namespace Profiler
+{
+	// Events each thread can hold between flushes.
+	const unsigned int RING_CAPACITY = 16384;
+
+	void Record(const char* name, unsigned long long begin_ticks, unsigned long long end_ticks);
+	void SetThreadName(const char* name, int index);
+
+	// Moves the recorded events of every thread into the trace.
+	void Flush();
+
+	// Flushes and writes the trace as Chrome trace-event JSON. Returns false if the file
+	// could not be written.
+	bool WriteChromeTrace(const char* path);
+
+	size_t GetEventCount();
+
+	inline unsigned long long GetTicks()
+	{
+		return Timer::GetTicks(TIMER_SOURCE_TSC);
+	}
+}
+
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name)
+		: m_name(name), m_begin(Profiler::GetTicks())
+	{
+	}
+
+	~ProfileZone()
+	{
+		Profiler::Record(m_name, m_begin, Profiler::GetTicks());
+	}
+
+private:
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+
+	const char* m_name;
+	unsigned long long m_begin;
+};
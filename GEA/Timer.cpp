@@ -1,29 +1,222 @@
 #include "Timer.h"
 
-Timer::Timer()
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TIMER_X86
+#endif
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef TIMER_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
 {
-	QueryPerformanceFrequency(&frequency);
+	const double TSC_CALIBRATION_SECONDS = 0.02;
+	const unsigned TIMER_OVERHEAD_SAMPLES = 10000;
+
+	struct TimerCalibration
+	{
+		bool hasTSC;
+		double frequency[TIMER_SOURCE_COUNT];
+		unsigned long long overhead[TIMER_SOURCE_COUNT];
+	};
+
+	unsigned long long ReadOS()
+	{
+#ifdef _WIN32
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart;
+#else
+		timespec time;
+#ifdef CLOCK_MONOTONIC_RAW
+		clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+#else
+		clock_gettime(CLOCK_MONOTONIC, &time);
+#endif
+		return (unsigned long long)time.tv_sec * 1000000000ULL + time.tv_nsec;
+#endif
+	}
+
+	double GetOSFrequency()
+	{
+#ifdef _WIN32
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return (double)frequency.QuadPart;
+#else
+		return 1000000000.0;
+#endif
+	}
+
+	// The fences keep the measured code from being reordered around the reads: lfence
+	// before rdtsc waits for earlier instructions, rdtscp waits for everything before the
+	// stop, and the trailing lfences keep later instructions from starting early.
+	inline unsigned long long ReadTSCStart()
+	{
+#ifdef TIMER_X86
+		_mm_lfence();
+		unsigned long long ticks = __rdtsc();
+		_mm_lfence();
+		return ticks;
+#else
+		return ReadOS();
+#endif
+	}
+
+	inline unsigned long long ReadTSCStop()
+	{
+#ifdef TIMER_X86
+		unsigned int aux;
+		unsigned long long ticks = __rdtscp(&aux);
+		_mm_lfence();
+		return ticks;
+#else
+		return ReadOS();
+#endif
+	}
+
+	// The TSC is only usable as a clock if it runs at a constant rate through frequency
+	// and power state changes, and rdtscp is needed for the stop read.
+	bool DetectTSC()
+	{
+#ifdef TIMER_X86
+		unsigned int regs[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+		__cpuid((int*)regs, 0x80000000);
+		if (regs[0] < 0x80000007)
+			return false;
+		__cpuid((int*)regs, 0x80000001);
+		bool rdtscp = (regs[3] & (1u << 27)) != 0;
+		__cpuid((int*)regs, 0x80000007);
+		bool invariant = (regs[3] & (1u << 8)) != 0;
+#else
+		if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+			return false;
+		__get_cpuid(0x80000001, &regs[0], &regs[1], &regs[2], &regs[3]);
+		bool rdtscp = (regs[3] & (1u << 27)) != 0;
+		__get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+		bool invariant = (regs[3] & (1u << 8)) != 0;
+#endif
+		return rdtscp && invariant;
+#else
+		return false;
+#endif
+	}
+
+	TimerCalibration Calibrate()
+	{
+		TimerCalibration calibration;
+		calibration.hasTSC = DetectTSC();
+		calibration.frequency[TIMER_SOURCE_OS] = GetOSFrequency();
+
+		// Count TSC ticks over a short stretch of OS clock time.
+		if (calibration.hasTSC)
+		{
+			double osFrequency = calibration.frequency[TIMER_SOURCE_OS];
+			unsigned long long osStart = ReadOS();
+			unsigned long long tscStart = ReadTSCStart();
+			unsigned long long osStop;
+			do
+			{
+				osStop = ReadOS();
+			} while ((osStop - osStart) < TSC_CALIBRATION_SECONDS * osFrequency);
+			unsigned long long tscStop = ReadTSCStop();
+
+			calibration.frequency[TIMER_SOURCE_TSC] = (double)(tscStop - tscStart) * osFrequency / (double)(osStop - osStart);
+		}
+		else
+		{
+			calibration.frequency[TIMER_SOURCE_TSC] = calibration.frequency[TIMER_SOURCE_OS];
+		}
+
+		// Overhead is the fastest empty measurement, anything above it is noise.
+		unsigned long long osOverhead = (unsigned long long)-1;
+		unsigned long long tscOverhead = (unsigned long long)-1;
+		for (unsigned i = 0; i < TIMER_OVERHEAD_SAMPLES; ++i)
+		{
+			unsigned long long start = ReadOS();
+			unsigned long long elapsed = ReadOS() - start;
+			if (elapsed < osOverhead)
+				osOverhead = elapsed;
+
+			if (calibration.hasTSC)
+			{
+				start = ReadTSCStart();
+				elapsed = ReadTSCStop() - start;
+				if (elapsed < tscOverhead)
+					tscOverhead = elapsed;
+			}
+		}
+
+		calibration.overhead[TIMER_SOURCE_OS] = osOverhead;
+		calibration.overhead[TIMER_SOURCE_TSC] = calibration.hasTSC ? tscOverhead : osOverhead;
+		return calibration;
+	}
+
+	// Runs during static initialization, before any Timer is created.
+	const TimerCalibration s_calibration = Calibrate();
+}
+
+Timer::Timer(TimerSource source)
+	: m_start(0)
+{
+	m_source = (source == TIMER_SOURCE_TSC && !s_calibration.hasTSC) ? TIMER_SOURCE_OS : source;
 }
 
 void Timer::Start()
 {
-	QueryPerformanceCounter(&start);
+	m_start = m_source == TIMER_SOURCE_TSC ? ReadTSCStart() : ReadOS();
 }
 
 double Timer::Stop()
 {
-	LARGE_INTEGER stop;
-	QueryPerformanceCounter(&stop);
+	unsigned long long stop = m_source == TIMER_SOURCE_TSC ? ReadTSCStop() : ReadOS();
+
+	// Get the elapsed time in ticks, without the cost of reading the clock.
+	unsigned long long elapsed = stop - m_start;
+	unsigned long long overhead = s_calibration.overhead[m_source];
+	elapsed = elapsed > overhead ? elapsed - overhead : 0;
+
+	// Convert ticks to milliseconds.
+	return (double)elapsed * 1000.0 / s_calibration.frequency[m_source];
+}
+
+TimerSource Timer::GetSource() const
+{
+	return m_source;
+}
 
-	// Get the elapsed time in ticks.
-	LARGE_INTEGER elapsed;
-	elapsed.QuadPart = stop.QuadPart - start.QuadPart;
+bool Timer::HasTSC()
+{
+	return s_calibration.hasTSC;
+}
 
-	// Multiply by million. Guards against precision loss.
-	elapsed.QuadPart *= 1000000;
+double Timer::GetFrequency(TimerSource source)
+{
+	if (source == TIMER_SOURCE_TSC && !s_calibration.hasTSC)
+		source = TIMER_SOURCE_OS;
+	return s_calibration.frequency[source];
+}
 
-	// Convert ticks to microseconds.
-	elapsed.QuadPart /= frequency.QuadPart;
+double Timer::GetOverhead(TimerSource source)
+{
+	if (source == TIMER_SOURCE_TSC && !s_calibration.hasTSC)
+		source = TIMER_SOURCE_OS;
+	return (double)s_calibration.overhead[source] * 1000.0 / s_calibration.frequency[source];
+}
 
-	return double(elapsed.QuadPart) / 1000.0;
-}
\ No newline at end of file
+unsigned long long Timer::GetTicks(TimerSource source)
+{
+	return source == TIMER_SOURCE_TSC && s_calibration.hasTSC ? ReadTSCStart() : ReadOS();
+}
@@ -1,19 +1,47 @@
 #pragma once
 
-#include <Windows.h>
+enum TimerSource
+{
+	// QueryPerformanceCounter on Windows, clock_gettime(CLOCK_MONOTONIC_RAW) elsewhere.
+	TIMER_SOURCE_OS,
+	// Time stamp counter read with rdtsc/rdtscp, for timing single calls. Falls back to
+	// TIMER_SOURCE_OS when the CPU has no invariant TSC or no rdtscp.
+	TIMER_SOURCE_TSC,
+	TIMER_SOURCE_COUNT
+};
 
+/*
+	High-resolution interval timer.
+
+	Both sources are read as raw ticks. The TSC frequency is calibrated against the OS
+	clock once at startup. The cost of an empty Start/Stop pair is measured at the same
+	time and subtracted from every Stop, so short intervals do not include the time
+	spent reading the clock.
+*/
 class Timer
 {
 public:
-	Timer();
+	Timer(TimerSource source = TIMER_SOURCE_OS);
 
 	// Restarts the timer.
 	void Start();
 
-	// Stops the timer and returns the time measured in seconds.
+	// Stops the timer and returns the time measured in milliseconds, minus the timer overhead.
 	double Stop();
+
+	// Source actually used, TIMER_SOURCE_OS if the TSC was requested but is unusable.
+	TimerSource GetSource() const;
+
+	// Whether TIMER_SOURCE_TSC is backed by the time stamp counter.
+	static bool HasTSC();
+	// Ticks per second of a source.
+	static double GetFrequency(TimerSource source);
+	// Time of an empty Start/Stop pair in milliseconds, which Stop subtracts.
+	static double GetOverhead(TimerSource source);
+	// Current tick count of a source, for timestamps. Convert with GetFrequency.
+	static unsigned long long GetTicks(TimerSource source);
+
 private:
-	LARGE_INTEGER frequency;
-	LARGE_INTEGER start;
+	TimerSource m_source;
+	unsigned long long m_start;
 };
-
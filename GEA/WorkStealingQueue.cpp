@@ -0,0 +1,69 @@
+#include "WorkStealingQueue.h"
+#include <cassert>
+
+WorkStealingQueue::WorkStealingQueue(unsigned capacity)
+	: m_jobs(nullptr), m_mask(capacity - 1), m_top(0), m_bottom(0)
+{
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Capacity must be a power of two");
+
+	m_jobs = new std::atomic<Job*>[capacity];
+}
+
+WorkStealingQueue::~WorkStealingQueue()
+{
+	delete [] m_jobs;
+}
+
+void WorkStealingQueue::Push(Job* job)
+{
+	long long bottom = m_bottom.load(std::memory_order_relaxed);
+	long long top = m_top.load(std::memory_order_acquire);
+	assert(bottom - top <= m_mask && "Work-stealing queue overflow");
+	(void)top;
+
+	m_jobs[bottom & m_mask].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+Job* WorkStealingQueue::Pop()
+{
+	long long bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// Empty, undo the reservation.
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_jobs[bottom & m_mask].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// Last job, race the thieves for it.
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+Job* WorkStealingQueue::Steal()
+{
+	long long top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long bottom = m_bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+		return nullptr;
+
+	Job* job = m_jobs[top & m_mask].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+
+	return job;
+}
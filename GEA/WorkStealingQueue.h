@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+struct Job;
+
+/*
+	Bounded Chase-Lev work-stealing deque of jobs.
+
+	The owning worker pushes and pops at the bottom, like a stack, so it keeps working on
+	what it touched last. Other workers steal from the top, the oldest jobs. Only the last
+	job can be contended, which is settled with a single CAS on top.
+*/
+class WorkStealingQueue
+{
+public:
+	// capacity must be a power of two.
+	WorkStealingQueue(unsigned capacity);
+	~WorkStealingQueue();
+
+	// Owner only. The queue must not be full.
+	void Push(Job* job);
+	// Owner only. Returns nullptr when the queue is empty.
+	Job* Pop();
+	// Any thread. Returns nullptr when the queue is empty or the steal lost a race.
+	Job* Steal();
+
+private:
+	WorkStealingQueue(const WorkStealingQueue&);
+	WorkStealingQueue& operator=(const WorkStealingQueue&);
+
+	std::atomic<Job*>* m_jobs;
+	long long m_mask;
+
+	std::atomic<long long> m_top;
+	// Keeps the thieves' top and the owner's bottom on separate cache lines.
+	char m_padding[64];
+	std::atomic<long long> m_bottom;
+};